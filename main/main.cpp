@@ -5,16 +5,25 @@
 #include <cmath>
 #include <ctime>
 #include <cstring>
+#include <string>
 #include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "data_structs.hpp"
 #include "params.hpp"
 #include "orchard.hpp"
+#include "bin_store.hpp"
+#include "worker_model.hpp"
+#include "request_queue.hpp"
+#include "harvest_kernel.hpp"
+#include "event_queue.hpp"
+#include "thread_pool.hpp"
 #include "agent.hpp"
 #include "auto_agent.hpp"
-
-FILE *logFile;
-FILE *repoFile;
-std::vector<FILE*> agentFiles;
+#include "trace.hpp"
+#include "log.hpp"
 
 int parseArgInt(char *arg)
 {
@@ -23,128 +32,128 @@ int parseArgInt(char *arg)
     return atoi(tmp);
 }
 
-int getNumWorkersAt(std::vector<Worker> workers, Coordinate loc)
+char *parseArgStr(char *arg)
 {
-    int count = 0;
-    for (int w = 0; w < (int) workers.size(); ++w) {
-        if (workers[w].loc.x == loc.x && workers[w].loc.y == loc.y)
-            count++;
-    }
-    return count;
+    char *tmp = strchr(arg, '=');
+    return (tmp == NULL) ? NULL : tmp + 1;
 }
 
-Coordinate findNewAppleLocation(std::vector<Worker> workers, Coordinate curLoc, Orchard env)
+// False, after an error, if the -dir name is longer than maxLen characters
+bool checkLogDir(const char *dir, int maxLen)
 {
+    if ((int) strlen(dir) <= maxLen)
+        return true;
+    LOG_ERROR(LOG_SIM, "The -dir name is longer than %d characters.\n", maxLen);
+    return false;
+}
+
+Coordinate findNewAppleLocation(const WorkerModel &workers, Coordinate curLoc, const Orchard &env)
+{
+    const int cols = env.getCols();
+    const CellIndex &index = env.getCellIndex();
+    
     // Search location at the same row, to the right columns
-    for (int c = curLoc.x + 1; c < ORCH_COLS - 1; ++c) {
-        Coordinate tmp(c, curLoc.y);
-        if (env.getApplesAt(tmp) > 0 && getNumWorkersAt(workers, tmp) == 0)
-            return tmp;
-    }
+    int c = index.findNextFree(curLoc.y, curLoc.x + 1, cols - 2);
+    if (c != -1)
+        return Coordinate(c, curLoc.y);
     
     // Search location at the same row, to the left columns
-    for (int c = curLoc.x - 1; c > 0; --c) {
-        Coordinate tmp(c, curLoc.y);
-        if (env.getApplesAt(tmp) > 0 && getNumWorkersAt(workers, tmp) == 0)
-            return tmp;
-    }
+    c = index.findPrevFree(curLoc.y, curLoc.x - 1, 1);
+    if (c != -1)
+        return Coordinate(c, curLoc.y);
     
-    // Search location at a different row (down)
-    for (int r = curLoc.y + 1; r < ORCH_ROWS; ++r) {
-        for (int c = ORCH_COLS - 2; c > 0; --c) {
-            Coordinate tmp(c, r); // Starts from the rightmost column
-            if (env.getApplesAt(tmp) > 0 && getNumWorkersAt(workers, tmp) == 0)
-                return tmp;
-        }
-    }
+    // Search location at a different row (down), starting from the rightmost column
+    int r = index.findNextFreeRow(curLoc.y + 1);
+    if (r != -1)
+        return Coordinate(index.findPrevFree(r, cols - 2, 1), r);
     
-    // Search location at a different row (up)
-    for (int r = curLoc.y - 1; r >= 0; --r) {
-        for (int c = ORCH_COLS - 2; c > 0; --c) {
-            Coordinate tmp(c, r); // Starts from the rightmost column
-            if (env.getApplesAt(tmp) > 0 && getNumWorkersAt(workers, tmp) == 0)
-                return tmp;
-        }
-    }
+    // Search location at a different row (up), starting from the rightmost column
+    r = (curLoc.y > 0) ? index.findPrevFreeRow(curLoc.y - 1) : -1;
+    if (r != -1)
+        return Coordinate(index.findPrevFree(r, cols - 2, 1), r);
     
-    // Still can't find a good location, join another group with the max ratio between apples and workers
+    // Still can't find a good location, join another group with the max ratio between apples and workers.
+    // Every cell with apples left is occupied at this point, so there are at most as many as worker groups.
     float maxRatio = 0;
     Coordinate maxLoc(-1, -1);
-    for (int r = 0; r < ORCH_ROWS; ++r) {
-        for (int c = 1; c < ORCH_COLS - 1; c++) {
+    for (int r = 0; r < env.getRows(); ++r) {
+        if (env.getRowApples(r) <= 0)
+            continue;
+        for (int c = index.findNextWithApples(r, 1, cols - 2); c != -1; c = index.findNextWithApples(r, c + 1, cols - 2)) {
             Coordinate tmp(c, r);
-            if (env.getApplesAt(tmp) == 0)
-                continue;
-            if (getNumWorkersAt(workers, tmp) == 0) {
+            int num = workers.countAt(tmp);
+            if (num == 0)
                 return tmp;
-            } else {
-                float ratio = env.getApplesAt(tmp) / (float) getNumWorkersAt(workers, tmp);
-                if (ratio > maxRatio) {
-                    maxRatio = ratio;
-                    maxLoc = tmp;
-                }
+            float ratio = env.getApplesAt(tmp) / (float) num;
+            if (ratio > maxRatio) {
+                maxRatio = ratio;
+                maxLoc = tmp;
             }
         }
     }
     return maxLoc;
 }
 
-Coordinate distributeWorkers(std::vector<Worker> &workers, std::vector<AppleBin> bins, Coordinate loc, Orchard env)
+Coordinate distributeWorkers(WorkerModel &workers, Coordinate loc, const Orchard &env)
 {
     Coordinate newLoc = findNewAppleLocation(workers, loc, env);
-    
-    // Move workers
-    for (int w = 0; w < (int) workers.size(); ++w) {
-        if (workers[w].loc.x != loc.x || workers[w].loc.y != loc.y)
-            continue;
-        workers[w].loc = newLoc;
-    }
-    
+    workers.moveGroup(loc, newLoc); // Also moves the occupancy
     return newLoc;
 }
 
-void writeBinInfo(const char *subdir, int time, AppleBin ab)
+// Agent positions, bin states and the repo count at the end of time step t
+void traceStep(TraceWriter &trace, int t, const std::vector<Coordinate> &agentLocs, const BinStore &bins, 
+    int numDelivered)
 {
-    char fname[50];
-    sprintf(fname, "logs/%s/bins/bin%d.csv", subdir, ab.id);
-    FILE *fp = fopen(fname, "a");
-    fprintf(fp, "%d,%d,%d,%4.2f\n", time, ab.loc.x, ab.loc.y, ab.capacity);
-    fclose(fp);
+    for (int a = 0; a < (int) agentLocs.size(); ++a)
+        trace.addAgent(t, a, agentLocs[a]);
+    for (int b = 0; b < (int) bins.size(); ++b)
+        trace.addBin(t, bins[b]);
+    trace.addRepo(t, numDelivered);
 }
 
-void registerLocation(Coordinate loc, std::vector<LocationRequest> &requests, int time)
+// Creates logs/<dir> and opens its trace; the run goes on untraced if that fails
+void openTrace(TraceWriter &trace, const char *dir)
 {
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (requests[i].loc.x == loc.x && requests[i].loc.y == loc.y)
-            return;
-    }
-    requests.push_back(loc);
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "logs/%s", dir);
+    bool ok = makeDirs(path);
+    snprintf(path, sizeof(path), "logs/%s/trace.bin", dir);
+    if (!ok || !trace.open(path))
+        LOG_WARN(LOG_SIM, "Cannot create %s; the run is not traced.\n", path);
 }
 
-std::vector<Worker> initWorkers()
+// Opens logs/<dir>/<name> for writing; NULL, after a warning, if it cannot be created
+FILE *openLogFile(const char *dir, const char *name)
 {
-    std::vector<Worker> workers;
-    for (int i = 0; i < NUM_WORKERS; ++i)
-        workers.push_back(Worker(i, 0, 0));
-    return workers;
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "logs/%s/%s", dir, name);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        LOG_WARN(LOG_SIM, "Cannot create %s; it is not written.\n", path);
+    return fp;
 }
 
-std::vector<Coordinate> initWorkerGroupsRandom(std::vector<Worker> &workers)
+void registerLocation(Coordinate loc, RequestQueue &requests)
+{
+    requests.add(loc); // No-op if the location is already requested
+}
+
+std::vector<Coordinate> initWorkerGroupsRandom(WorkerModel &workers, const Orchard &env)
 {
     std::vector<Coordinate> workerGroups;
     int count = 0;
     
     while (count < NUM_WORKERS) {
         // Get random coordinate
-        int x = rand() % (ORCH_COLS - 1) + 1;
-        int y = rand() % ORCH_ROWS;
+        int x = rand() % (env.getCols() - 1) + 1;
+        int y = rand() % env.getRows();
         // Get random number of workers for a group
         int num = rand() % 5 + 1;
         // Register workers' locations
         int prevCount = count;
         for (int n = prevCount; n < (prevCount + num) && n < NUM_WORKERS; ++n) {
-            workers[n].loc.x = x;
-            workers[n].loc.y = y;
+            workers.place(n, Coordinate(x, y));
             ++count;
             //printf("workers %d at location (%d, %d).\n", n, x, y);
         }
@@ -154,7 +163,7 @@ std::vector<Coordinate> initWorkerGroupsRandom(std::vector<Worker> &workers)
     return workerGroups;
 }
 
-std::vector<Coordinate> initWorkerGroupsFixed(std::vector<Worker> &workers, int eps)
+std::vector<Coordinate> initWorkerGroupsFixed(WorkerModel &workers, int eps)
 {
     std::vector<Coordinate> workerGroups;
     
@@ -163,9 +172,9 @@ std::vector<Coordinate> initWorkerGroupsFixed(std::vector<Worker> &workers, int
         workerGroups.push_back(Coordinate(3, 4));
         // Register workers' locations
         for (int i = 0; i < 5; ++i)
-            workers[i].loc = workerGroups[0];
+            workers.place(i, workerGroups[0]);
         for (int i = 5; i < 10; ++i)
-            workers[i].loc = workerGroups[1];
+            workers.place(i, workerGroups[1]);
     } /*else if (eps == 2) {
     
     }*/ else {
@@ -173,267 +182,556 @@ std::vector<Coordinate> initWorkerGroupsFixed(std::vector<Worker> &workers, int
         workerGroups.push_back(Coordinate(4, 3));
         // Register workers' locations
         for (int i = 0; i < 5; ++i)
-            workers[i].loc = workerGroups[0];
+            workers.place(i, workerGroups[0]);
         for (int i = 5; i < 10; ++i)
-            workers[i].loc = workerGroups[1];
+            workers.place(i, workerGroups[1]);
     }
     
     return workerGroups;
 }
     
 
-std::vector<AppleBin> initBins(std::vector<Coordinate> workerGroups, int *binCounter)
+BinStore initBins(std::vector<Coordinate> workerGroups, int *binCounter)
 {
-    std::vector<AppleBin> bins;
+    BinStore bins;
     
     for (int i = 0; i < (int) workerGroups.size(); ++i)
-        bins.push_back(AppleBin((*binCounter)++, workerGroups[i].x, workerGroups[i].y));
+        bins.add(AppleBin((*binCounter)++, workerGroups[i].x, workerGroups[i].y));
     
-    printf("Initial bin locations:\n");
+    LOG_INFO(LOG_SIM, "Initial bin locations:\n");
     for (int b = 0; b < (int) bins.size(); ++b) {
         bins[b].onGround = true;
-        printf("B%d at (%d,%d)\n", bins[b].id, bins[b].loc.x, bins[b].loc.y);
+        LOG_INFO(LOG_SIM, "B%d at (%d,%d)\n", bins[b].id, bins[b].loc.x, bins[b].loc.y);
     }
     
     return bins;
 }
 
-bool isRequestFulfilled(Coordinate loc, std::vector<AppleBin> bins)
+// Fill of every bin for this tick, computed in one pass before the bins are visited in order
+void prepareHarvest(HarvestBatch &harvest, const BinStore &bins, const Orchard &env, const WorkerModel &workers)
 {
-    for (int i = 0; i < (int) bins.size(); ++i) {
-        if (bins[i].onGround && bins[i].loc.x == loc.x && bins[i].loc.y == loc.y)
-            return true;
+    harvest.clear();
+    for (int b = 0; b < (int) bins.size(); ++b)
+        harvest.push(bins[b].loc, bins[b].capacity, bins[b].onGround, env.getApplesAt(bins[b].loc), 
+            workers.countAt(bins[b].loc));
+    resolveCellOwners(harvest, env.getRows(), env.getCols());
+    harvestBatch(harvest);
+}
+
+// Applies the precomputed fill of bin b; returns the number of workers at the bin
+int applyHarvest(HarvestBatch &harvest, BinStore &bins, int b, Orchard &env, const WorkerModel &workers)
+{
+    int num = workers.countAt(bins[b].loc);
+    if (num != harvest.workers[b]) // Workers moved here earlier in this tick
+        harvestBin(harvest, b, num);
+    if (harvest.harvested[b]) {
+        bins[b].fillRate = harvest.fillRate[b];
+        bins[b].capacity = harvest.newCapacity[b];
+        env.decreaseApplesAt(bins[b].loc, bins[b].fillRate);
     }
-    return false;
+    return num;
 }
 
-bool isHarvested(std::vector<AppleBin> bins, int index)
+/*
+ * Event jumps (-events). While no agent has anything to decide (see isQuiet), a tick changes nothing but the bins 
+ * being picked, the apples under them, and where the agents on a trip and the bins they carry are, so the run loop 
+ * jumps straight to the next tick in which something happens. Every bin being picked forecasts its next event: it 
+ * fills up or stops being picked, the apples at its cell run out (the workers move and request a location), or, 
+ * full, it requests its cell where someone would notice. Every agent on a trip forecasts when it arrives, and 
+ * when it stops on a cell where it would act or its bin comes to or leaves the workers (the bin is picked, or 
+ * keeps a later bin at their cell from being picked). The earliest event in the queue, or the time limit, ends 
+ * the jump. The skipped ticks fill the bins with the same float operations in the same order as the tick loop 
+ * and move the agents along the same routes in O(1), so repo counts, wait times and rewards come out the same, 
+ * and the workers and bins that wait stay the same throughout.
+ */
+
+// Queues the first tick from t on in which bin b's picking makes something happen, for every bin picked in tick 
+// t. churnIsQuiet: a full bin with workers and apples left requests its own cell every tick, which only matters 
+// if someone would see it.
+void forecastHarvest(EventQueue &queue, HarvestBatch &harvest, const BinStore &bins, const Orchard &env, 
+    const WorkerModel &workers, const RequestQueue &requests, bool churnIsQuiet, int t)
 {
-    for (int i = 0; i < (int) bins.size() && i < index; ++i) {
-        if (bins[i].loc.x == bins[index].loc.x && bins[i].loc.y == bins[index].loc.y)
-            return true;
+    prepareHarvest(harvest, bins, env, workers);
+    const int maxCap = BIN_CAPACITY;
+    for (int b = 0; b < (int) bins.size() && queue.top().time > t; ++b) {
+        int num = harvest.workers[b];
+        if (num == 0)
+            continue; // Never harvests anything, so never requests or moves anyone either
+        bool quietChurn = churnIsQuiet || requests.find(bins[b].loc) != -1; // A second request is a no-op
+        float capacity = harvest.capacity[b];
+        float apples = harvest.apples[b];
+        for (int k = t; k < queue.top().time; ++k) { // Events after the earliest one so far do not matter
+            int curCap = round(capacity);
+            if (!harvest.open[b] || apples <= 0 || curCap >= maxCap) {
+                // Not picked, and stays so until another bin's event; only tick t can have one
+                if (k == t && round(apples) <= 0)
+                    queue.push(t, EVENT_APPLES_OUT, b);
+                else if (k == t && apples > 0 && round(capacity) >= BIN_CAPACITY && !quietChurn)
+                    queue.push(t, EVENT_REQUEST, b);
+                break;
+            }
+            float r = num * PICK_RATE;
+            float c = capacity + r;
+            capacity = c;
+            apples = (r >= apples) ? 0 : apples - r;
+            // Filling up, running out of apples, or stopping short of full (the workers start waiting)
+            if (c >= BIN_CAPACITY || round(apples) <= 0 || round(capacity) >= BIN_CAPACITY) {
+                int kind = (c >= BIN_CAPACITY) ? EVENT_BIN_FULL : (round(apples) <= 0) ? EVENT_APPLES_OUT 
+                    : EVENT_BIN_STOPS;
+                queue.push(k, kind, b);
+                break;
+            }
+        }
     }
-    return false;
 }
 
-void runBase(const int NUM_AGENTS, const int TIME_LIMIT)
+// Moves, from 1 on, after which an agent going speed steps per tick from cur towards dst stands on loc, or 0 if 
+// it never stops there
+int countMovesTo(const DistanceOracle &dist, Coordinate cur, Coordinate dst, int speed, Coordinate loc)
+{
+    int steps = dist.getRouteSteps(cur, dst, loc);
+    if (steps <= 0)
+        return 0;
+    int moves = (steps + speed - 1) / speed;
+    Coordinate stop = dist.advance(cur, dst, moves * speed);
+    return (stop.x == loc.x && stop.y == loc.y) ? moves : 0;
+}
+
+// Queues the tick in which each agent on a trip (see isQuiet) arrives or stops where it has something to decide; 
+// an agent that moves in ticks t, t + 1, ... ends its trip in tick t + moves - 1
+template <class AgentT>
+void forecastTrips(EventQueue &queue, const std::vector<AgentT> &agents, const std::vector<Trip> &trips, 
+    const WorkerModel &workers, const RequestQueue &requests, const DistanceOracle &dist, int t)
 {
-    system("rm -rf logs/base");
-    system("mkdir logs/base");
-    system("mkdir -p logs/base/agents");
-    system("mkdir -p logs/base/bins");
+    for (int a = 0; a < (int) agents.size(); ++a) {
+        const Trip &trip = trips[a];
+        if (trip.speed == 0)
+            continue;
+        Coordinate cur = agents[a].getCurLoc();
+        Coordinate end = dist.advance(cur, trip.dst, INT_MAX);
+        int steps = dist.getRouteSteps(cur, trip.dst, end);
+        int moves = (steps + trip.speed - 1) / trip.speed; // Arrival
+        int kind = EVENT_AGENT_ARRIVES;
+        for (int dy = -trip.margin; dy <= trip.margin; ++dy) { // Close enough to decide
+            for (int dx = abs(dy) - trip.margin; dx <= trip.margin - abs(dy); ++dx) {
+                int m = countMovesTo(dist, cur, trip.dst, trip.speed, Coordinate(trip.dst.x + dx, trip.dst.y + dy));
+                if (m > 0 && m < moves)
+                    moves = m;
+            }
+        }
+        int stops = countMovesTo(dist, cur, trip.dst, trip.speed, trip.watch);
+        if (trip.atRepo) { // The repo column; whatever the route does there, the first move that may reach it
+            int s = dist.getRouteSteps(cur, trip.dst, Coordinate(0, cur.y));
+            if (s > 0 && (stops == 0 || (s + trip.speed - 1) / trip.speed < stops))
+                stops = (s + trip.speed - 1) / trip.speed;
+        }
+        if (trip.clearsRequests) {
+            for (int r = requests.first(); r != -1; r = requests.next(r)) {
+                int m = countMovesTo(dist, cur, trip.dst, trip.speed, requests.get(r).loc);
+                if (m > 0 && (stops == 0 || m < stops))
+                    stops = m;
+            }
+        }
+        if (trip.bin != -1) { // A carried bin at the workers is picked, or takes the cell from a later bin
+            const std::vector<Worker> &pickers = workers.getWorkers();
+            for (int w = 0; w < (int) pickers.size(); ++w) {
+                if (pickers[w].loc.x == cur.x && pickers[w].loc.y == cur.y) {
+                    stops = 1; // Leaving them changes the picking
+                    break;
+                }
+                int m = countMovesTo(dist, cur, trip.dst, trip.speed, pickers[w].loc);
+                if (m > 0 && (stops == 0 || m < stops))
+                    stops = m;
+            }
+        }
+        if (stops > 0 && stops < moves) {
+            moves = stops;
+            kind = EVENT_AGENT_STOPS;
+        }
+        queue.push(t + moves - 1, kind, a);
+    }
+}
+
+// The harvest of ticks t .. end - 1, which no event interrupts; harvest holds tick t as forecastHarvest prepared it
+void skipTicks(HarvestBatch &harvest, BinStore &bins, Orchard &env, int t, int end)
+{
+    std::vector<int> picking; // Bins harvested in tick t; no other bin changes until end
+    for (int b = 0; b < (int) bins.size(); ++b) {
+        if (harvest.harvested[b])
+            picking.push_back(b);
+    }
+    const int maxCap = BIN_CAPACITY;
+    for (int k = t; k < end && !picking.empty(); ++k) {
+        for (int i = 0; i < (int) picking.size(); ++i) {
+            AppleBin &ab = bins[picking[i]];
+            int curCap = round(ab.capacity);
+            if (env.getApplesAt(ab.loc) > 0 && curCap < maxCap) {
+                ab.fillRate = harvest.workers[picking[i]] * PICK_RATE;
+                ab.capacity = ab.capacity + ab.fillRate;
+                env.decreaseApplesAt(ab.loc, ab.fillRate);
+            }
+        }
+    }
+}
+
+// How long workers and full bins waited in one episode
+struct WaitStats
+{
+    long long workerSteps; // Time steps a worker spent at apples with no bin being filled there
+    long long binSteps; // Time steps a full bin spent on the ground waiting to be picked up
+    int binsFilled;
+    WaitStats() : workerSteps(0), binSteps(0), binsFilled(0) {}
+};
+
+// Adds the waits of the tick harvest was prepared for, ticks times over (skipped ticks wait alike)
+void countWaits(WaitStats &waits, const HarvestBatch &harvest, const BinStore &bins, const Orchard &env, 
+    const WorkerModel &workers, int ticks)
+{
+    long long waiting = 0;
+    const std::vector<Worker> &ws = workers.getWorkers();
+    for (int w = 0; w < (int) ws.size(); ++w) {
+        if (env.getApplesAt(ws[w].loc) > 0)
+            ++waiting;
+    }
+    long long full = 0;
+    for (int b = 0; b < harvest.size(); ++b) {
+        if (harvest.harvested[b])
+            waiting -= harvest.workers[b];
+        else if (bins[b].onGround && harvest.capacity[b] >= BIN_CAPACITY)
+            ++full;
+    }
+    waits.workerSteps += waiting * ticks;
+    waits.binSteps += full * ticks;
+}
+
+// One row of logs/<dir>/summary.csv: episode, total bins, remaining apples, mean human wait, mean bin wait
+void writeSummary(FILE *fp, int eps, int totalBins, float remaining, const WaitStats &waits, int numWorkers)
+{
+    double humanWait = (numWorkers > 0) ? waits.workerSteps / (double) numWorkers : 0;
+    double binWait = (waits.binsFilled > 0) ? waits.binSteps / (double) waits.binsFilled : 0;
+    fprintf(fp, "%d,%d,%.2f,%.2f,%.2f\n", eps, totalBins, remaining, humanWait, binWait);
+    fflush(fp);
+}
+
+// Creates logs/<dir> and opens its summary.csv
+FILE *openSummary(const char *dir)
+{
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "logs/%s", dir);
+    makeDirs(path);
+    snprintf(path, sizeof(path), "logs/%s/summary.csv", dir);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        LOG_WARN(LOG_SIM, "Cannot create %s; the run is not summarized.\n", path);
+    return fp;
+}
+
+// Logged under logs/<LOG_DIR>
+void runBase(const int NUM_AGENTS, const int TIME_LIMIT, const int NUM_ROWS, const int NUM_COLS, 
+    const char *YIELD_MAP, bool events, const char *LOG_DIR)
+{
+    TraceWriter trace;
+    openTrace(trace, LOG_DIR);
+    FILE *summaryFile = openSummary(LOG_DIR);
     
-    // Prepare log files
-    FILE *repoFile = fopen("logs/base/repo.csv", "w");
+    /* Initialize orchard environment with uniform distribution of apples */
+    Orchard env(NUM_ROWS, NUM_COLS, YIELD_MAP);
     
     int binCounter = 0;
-    std::vector<Worker> workers = initWorkers();
+    WorkerModel workers(env, NUM_WORKERS);
     std::vector<Coordinate> workerGroups = initWorkerGroupsFixed(workers, 0);
-    std::vector<AppleBin> bins = initBins(workerGroups, &binCounter);
+    BinStore bins = initBins(workerGroups, &binCounter);
     
     std::vector<Agent> agents;
-    for (int i = 0; i < NUM_AGENTS; ++i) {
-        agents.push_back(Agent(i, Coordinate(0, 0)));
-        char fname[50];
-        sprintf(fname, "logs/base/agents/agent%d.csv", i);
-        FILE *fp = fopen(fname, "w");
-        agentFiles.push_back(fp);
-    }
+    for (int i = 0; i < NUM_AGENTS; ++i)
+        agents.push_back(Agent(i, Coordinate(0, 0), env));
+    std::vector<Coordinate> agentLocs(NUM_AGENTS);
     
-    /* Initialize orchard environment with uniform distribution of apples */
-    Orchard env;
     std::vector<AppleBin> repo;
-    std::vector<LocationRequest> requests;
+    RequestQueue requests;
+    AgentWorld world(env, bins, agents, workers, requests, repo, &binCounter);
+    HarvestBatch harvest;
+    EventQueue queue;
+    std::vector<Trip> trips;
+    int numSkipped = 0;
+    WaitStats waits;
     
     /* Run simulator */
     for (int t = 0; t < TIME_LIMIT; ++t) {
-        printf("------------ T = %d ------------\n", t);
+        if (events && Agent::isQuiet(world, trips)) {
+            queue.clear();
+            queue.push(TIME_LIMIT, EVENT_TIME_LIMIT, -1);
+            forecastTrips(queue, agents, trips, workers, requests, env.getDistance(), t);
+            forecastHarvest(queue, harvest, bins, env, workers, requests, false, t);
+            int next = queue.top().time;
+            countWaits(waits, harvest, bins, env, workers, next - t);
+            skipTicks(harvest, bins, env, t, next);
+            for (int a = 0; a < NUM_AGENTS; ++a)
+                agents[a].followTrip(world, trips[a], next - t);
+            numSkipped += next - t;
+            t = next;
+            if (t == TIME_LIMIT)
+                break;
+            LOG_DEBUG(LOG_SIM, "Jumped to T = %d: %s %d\n", t, EventQueue::getKindName(queue.top().kind), 
+                queue.top().index);
+        }
+        LOG_DEBUG(LOG_SIM, "------------ T = %d ------------\n", t);
         // Simulate bins and workers
         // Harvest only happens when there's bin on the location. Downside: workers will have to wait for bins.
+        prepareHarvest(harvest, bins, env, workers);
+        countWaits(waits, harvest, bins, env, workers, 1);
         for (int b = 0; b < (int) bins.size(); ++b) {
-            int num = getNumWorkersAt(workers, bins[b].loc);
-            int tmp1 = round(bins[b].capacity);
-            int tmp2 = BIN_CAPACITY;
-            if (env.getApplesAt(bins[b].loc) > 0 && tmp1 < tmp2 && bins[b].onGround && !isHarvested(bins, b)) {
-                bins[b].fillRate = num * PICK_RATE;
-                bins[b].capacity += bins[b].fillRate; // capacity increase for each time step = fill rate * 1
-                env.decreaseApplesAt(bins[b].loc, bins[b].fillRate);
-                if (bins[b].capacity > BIN_CAPACITY)
-                    bins[b].capacity = BIN_CAPACITY;
-            }
-            printf("[%d] B%d (%d,%d) capacity: %4.2f. (# workers: %d)\n", t, bins[b].id, bins[b].loc.x, 
+            int num = applyHarvest(harvest, bins, b, env, workers);
+            waits.binsFilled += harvest.full[b];
+            LOG_DEBUG(LOG_HARVEST, "[%d] B%d (%d,%d) capacity: %4.2f. (# workers: %d)\n", t, bins[b].id, bins[b].loc.x, 
                 bins[b].loc.y, bins[b].capacity, num);
             if (bins[b].onGround) {
-                printf("[%d] Remaining apples at (%d,%d): %4.2f\n", t, bins[b].loc.x, bins[b].loc.y, 
+                LOG_DEBUG(LOG_HARVEST, "[%d] Remaining apples at (%d,%d): %4.2f\n", t, bins[b].loc.x, bins[b].loc.y, 
                     env.getApplesAt(bins[b].loc));
             }
             
             if (num > 0 && round(env.getApplesAt(bins[b].loc)) <= 0) { // No more apples at current location
-                Coordinate tmp = distributeWorkers(workers, bins, bins[b].loc, env);
-                if (tmp.x > 0 && tmp.x < ORCH_COLS - 1 && tmp.y >= 0 && tmp.y < ORCH_ROWS) {
-                    registerLocation(tmp, requests, t);
-                    printf("[%d] No more apples at (%d,%d). %d workers move to (%d,%d).\n", t, bins[b].loc.x, 
-                        bins[b].loc.y, num, tmp.x, tmp.y);
+                Coordinate tmp = distributeWorkers(workers, bins[b].loc, env);
+                if (tmp.x > 0 && tmp.x < env.getCols() - 1 && tmp.y >= 0 && tmp.y < env.getRows()) {
+                    registerLocation(tmp, requests);
+                    LOG_DEBUG(LOG_HARVEST, "[%d] No more apples at (%d,%d). %d workers move to (%d,%d).\n", t, 
+                        bins[b].loc.x, bins[b].loc.y, num, tmp.x, tmp.y);
                 }
             } else if (num > 0 && env.getApplesAt(bins[b].loc) > 0 && round(bins[b].capacity) >= BIN_CAPACITY) {
-                registerLocation(bins[b].loc, requests, t);
-                printf("There are still %4.2f apples at (%d,%d).\n", env.getApplesAt(bins[b].loc), bins[b].loc.x, bins[b].loc.y);
+                registerLocation(bins[b].loc, requests);
+                LOG_DEBUG(LOG_HARVEST, "There are still %4.2f apples at (%d,%d).\n", env.getApplesAt(bins[b].loc), 
+                    bins[b].loc.x, bins[b].loc.y);
             }
         }
         
-        for (int n = 0; n < (int) requests.size(); ++n) {
-            if (env.getApplesAt(requests[n].loc) == 0) {
-                requests.erase(requests.begin() + n);
-                --n;
-            } else {
-                printf("[%d] Location requests: (%d,%d). Remaining apples: %4.2f\n", t, requests[n].loc.x, 
-                    requests[n].loc.y, env.getApplesAt(requests[n].loc));
-            }
+        for (int n = requests.first(); n != -1; ) {
+            Coordinate loc = requests.get(n).loc;
+            int next = requests.next(n);
+            if (env.getApplesAt(loc) == 0)
+                requests.remove(n);
+            else
+                LOG_DEBUG(LOG_HARVEST, "[%d] Location requests: (%d,%d). Remaining apples: %4.2f\n", t, loc.x, loc.y, 
+                    env.getApplesAt(loc));
+            n = next;
         }
         
         // Simulate agents
         for (int a = 0; a < NUM_AGENTS; ++a) {
-            agents[a].takeAction(&binCounter, bins, repo, agents, env, requests);
-            Coordinate atmp = agents[a].getCurLoc();
-            fprintf(agentFiles[a], "%d,%d,%d\n", t, atmp.x, atmp.y);
+            agents[a].takeAction(world);
+            agentLocs[a] = agents[a].getCurLoc();
         }
-        
-        for (int b = 0; b < (int) bins.size(); ++b)
-            writeBinInfo("base", t, bins[b]);
-        
-        fprintf(repoFile, "%d,%d\n", t, (int) repo.size());
+        traceStep(trace, t, agentLocs, bins, (int) repo.size());
         
         int appleLocCount = 0;
         if (env.getTotalApples(&appleLocCount) == 0 && repo.size() >= 80) {
-            printf("No more apples in orchard. Terminating simulation.\n");
+            LOG_INFO(LOG_SIM, "No more apples in orchard. Terminating simulation.\n");
             break;
         }
     }
     
-    printf("------------ END OF SIMULATION ------------\n");
-    printf("Total bins: %d\n", (int) repo.size());
+    LOG_INFO(LOG_SIM, "------------ END OF SIMULATION ------------\n");
+    LOG_INFO(LOG_SIM, "Total bins: %d\n", (int) repo.size());
+    if (events)
+        LOG_INFO(LOG_SIM, "Event jumps skipped %d time steps.\n", numSkipped);
+    if (summaryFile != NULL) {
+        int cellCount = 0;
+        writeSummary(summaryFile, 0, (int) repo.size(), env.getTotalApples(&cellCount), waits, workers.size());
+        fclose(summaryFile);
+    }
 }
 
-void runAutonomous(const int NUM_AGENTS, const int NUM_LAYERS, const int TIME_LIMIT, const int MAX_EPS, bool learn)
+struct PlanTask
 {
-    system("rm -rf logs/auto");
-    system("mkdir logs/auto");
-    system("mkdir -p logs/auto/agents");
-    system("mkdir -p logs/auto/bins");
+    std::vector<AutoAgent> *agents;
+    const AutoWorld *world;
+    const IdleBinSet *idle;
+};
+
+void planAgent(void *ctx, int a)
+{
+    PlanTask *task = (PlanTask *) ctx;
+    (*task->agents)[a].makePlans(*task->world, *task->idle);
+}
+
+// Episodes FIRST_EPS .. FIRST_EPS + MAX_EPS - 1, logged under logs/<LOG_DIR>; a SEED of -1 leaves rand() alone
+void runAutonomous(const int NUM_AGENTS, const int NUM_LAYERS, const int TIME_LIMIT, const int MAX_EPS, bool learn, 
+    const int NUM_ROWS, const int NUM_COLS, const char *YIELD_MAP, const int NUM_THREADS, bool optimal, 
+    const int PLAN_BUDGET, bool events, const char *LOG_DIR, const int FIRST_EPS, const int SEED)
+{
+    TraceWriter trace;
+    openTrace(trace, LOG_DIR);
+    FILE *auctionFile = openLogFile(LOG_DIR, "auction.csv"); // time, bids, assigned bins, assignment time (us)
+    FILE *planFile = openLogFile(LOG_DIR, "plan.csv"); // time, agents planned, plans cut short, longest plan (us)
+    FILE *summaryFile = openSummary(LOG_DIR);
     
-    // Prepare log files
-    FILE *repoFile = fopen("logs/auto/repo.csv", "w");
+    ThreadPool pool(NUM_THREADS);
+    AuctionEngine auction(optimal ? AuctionEngine::OPTIMAL : AuctionEngine::GREEDY);
     
     /* Run simulator */
-    for (int eps = 0; eps < MAX_EPS; ++eps) {
-        printf("+++++++++++++++ EPS = %d +++++++++++++++\n", eps);
+    for (int eps = FIRST_EPS; eps < FIRST_EPS + MAX_EPS; ++eps) {
+        LOG_INFO(LOG_SIM, "+++++++++++++++ EPS = %d +++++++++++++++\n", eps);
+        if (SEED != -1)
+            srand(SEED + eps);
         /* Workers and bins initialization */
+        /* Initialize orchard environment with uniform distribution of apples */
+        Orchard env(NUM_ROWS, NUM_COLS, YIELD_MAP);
         int binCounter = 0;
-        std::vector<Worker> workers = initWorkers();
+        WorkerModel workers(env, NUM_WORKERS);
         std::vector<Coordinate> workerGroups = initWorkerGroupsFixed(workers, eps);
-        std::vector<AppleBin> bins = initBins(workerGroups, &binCounter);
+        BinStore bins = initBins(workerGroups, &binCounter);
         /* Agents initialization */
         std::vector<AutoAgent> agents;
-        for (int i = 0; i < NUM_AGENTS; ++i) {
-            agents.push_back(AutoAgent(i, Coordinate(0, 0), NUM_LAYERS, learn));
-            char fname[50];
-            sprintf(fname, "logs/auto/agents/agent%d.csv", i);
-            FILE *fp = fopen(fname, "a");
-            agentFiles.push_back(fp);
-        }
-        /* Initialize orchard environment with uniform distribution of apples */
-        Orchard env;
+        for (int i = 0; i < NUM_AGENTS; ++i)
+            agents.push_back(AutoAgent(i, Coordinate(0, 0), NUM_LAYERS, env, learn));
+        std::vector<Coordinate> agentLocs(NUM_AGENTS);
         std::vector<AppleBin> repo;
-        std::vector<LocationRequest> requests;
+        RequestQueue requests;
+        AutoWorld world(env, bins, agents, workers, requests, repo, &binCounter);
+        for (int a = 0; a < NUM_AGENTS; ++a) {
+            agents[a].trackRequests(&requests);
+            agents[a].setPlanBudget(PLAN_BUDGET);
+        }
+        int numPlanned = 0;
+        int numCut = 0;
+        int numSkipped = 0;
+        WaitStats waits;
+        HarvestBatch harvest;
+        EventQueue queue;
+        std::vector<Trip> trips;
+        IdleBinSet idle;
         int initCells = 0;
         float initApples = env.getTotalApples(&initCells);
-        printf("Initial number of apples at orchard: %4.2f in %d location.\n", initApples, initCells);
+        LOG_INFO(LOG_SIM, "Initial number of apples at orchard: %4.2f in %d location.\n", initApples, initCells);
         
         for (int t = 0; t < TIME_LIMIT; ++t) {
-            printf("------------ T = %d ------------\n", t);
+            bool parked;
+            if (events && AutoAgent::isQuiet(world, &parked, trips)) {
+                queue.clear();
+                queue.push(TIME_LIMIT, EVENT_TIME_LIMIT, -1);
+                forecastTrips(queue, agents, trips, workers, requests, env.getDistance(), t);
+                forecastHarvest(queue, harvest, bins, env, workers, requests, !parked, t);
+                int next = queue.top().time;
+                countWaits(waits, harvest, bins, env, workers, next - t);
+                skipTicks(harvest, bins, env, t, next);
+                for (int a = 0; a < NUM_AGENTS; ++a)
+                    agents[a].followTrip(world, trips[a], next - t);
+                numSkipped += next - t;
+                t = next;
+                if (t == TIME_LIMIT)
+                    break;
+                LOG_DEBUG(LOG_SIM, "Jumped to T = %d: %s %d\n", t, EventQueue::getKindName(queue.top().kind), 
+                    queue.top().index);
+            }
+            LOG_DEBUG(LOG_SIM, "------------ T = %d ------------\n", t);
             // Simulate bins and workers
+            prepareHarvest(harvest, bins, env, workers);
+            countWaits(waits, harvest, bins, env, workers, 1);
             for (int b = 0; b < (int) bins.size(); ++b) {
-                int num = getNumWorkersAt(workers, bins[b].loc);
-                int tmp1 = round(bins[b].capacity);
-                int tmp2 = BIN_CAPACITY;
-                if (env.getApplesAt(bins[b].loc) > 0 && tmp1 < tmp2 && bins[b].onGround && !isHarvested(bins, b)) {
-                    bins[b].fillRate = num * PICK_RATE;
-                    bins[b].capacity += bins[b].fillRate; // capacity increase for each time step = fill rate * 1
-                    env.decreaseApplesAt(bins[b].loc, bins[b].fillRate);
-                    if (bins[b].capacity >= BIN_CAPACITY) {
-                        bins[b].capacity = BIN_CAPACITY;
-                        bins[b].filledTime = t;
-                    }
+                int num = applyHarvest(harvest, bins, b, env, workers);
+                if (harvest.full[b]) {
+                    bins[b].filledTime = t;
+                    ++waits.binsFilled;
                 }
                 
                 const char *str = (bins[b].onGround) ? "on ground" : "carried";
-                printf("[%d] B%d (%d,%d) %s, capacity: %4.2f. (# workers: %d)\n", t, bins[b].id, bins[b].loc.x, 
-                    bins[b].loc.y, str, bins[b].capacity, num);
+                LOG_DEBUG(LOG_HARVEST, "[%d] B%d (%d,%d) %s, capacity: %4.2f. (# workers: %d)\n", t, bins[b].id, 
+                    bins[b].loc.x, bins[b].loc.y, str, bins[b].capacity, num);
                 if (bins[b].onGround) {
-                    printf("[%d] Remaining apples at (%d,%d): %4.2f\n", t, bins[b].loc.x, bins[b].loc.y, 
-                        env.getApplesAt(bins[b].loc));
+                    LOG_DEBUG(LOG_HARVEST, "[%d] Remaining apples at (%d,%d): %4.2f\n", t, bins[b].loc.x, 
+                        bins[b].loc.y, env.getApplesAt(bins[b].loc));
                 }
                 
                 if (num > 0 && round(env.getApplesAt(bins[b].loc)) <= 0) { // No more apples at current location
-                    Coordinate tmp = distributeWorkers(workers, bins, bins[b].loc, env);
-                    if (tmp.x > 0 && tmp.x < ORCH_COLS - 1 && tmp.y >= 0 && tmp.y < ORCH_ROWS) {
-                        registerLocation(tmp, requests, t);
-                        printf("[%d] No more apples at (%d,%d). %d workers move to (%d,%d).\n", t, bins[b].loc.x, 
-                            bins[b].loc.y, num, tmp.x, tmp.y);
+                    Coordinate tmp = distributeWorkers(workers, bins[b].loc, env);
+                    if (tmp.x > 0 && tmp.x < env.getCols() - 1 && tmp.y >= 0 && tmp.y < env.getRows()) {
+                        registerLocation(tmp, requests);
+                        LOG_DEBUG(LOG_HARVEST, "[%d] No more apples at (%d,%d). %d workers move to (%d,%d).\n", t, 
+                            bins[b].loc.x, bins[b].loc.y, num, tmp.x, tmp.y);
                     }
                 } else if (num > 0 && env.getApplesAt(bins[b].loc) > 0 && round(bins[b].capacity) >= BIN_CAPACITY) {
-                    registerLocation(bins[b].loc, requests, t);
+                    registerLocation(bins[b].loc, requests);
                 }
             }
             
-            for (int n = 0; n < (int) requests.size(); ++n) {
-                if (env.getApplesAt(requests[n].loc) == 0) {
-                    requests.erase(requests.begin() + n);
-                    --n;
-                } else {
-                    printf("[%d] Location requests: (%d,%d). Remaining apples: %4.2f\n", t, requests[n].loc.x, 
-                        requests[n].loc.y, env.getApplesAt(requests[n].loc));
-                }
+            for (int n = requests.first(); n != -1; ) {
+                Coordinate loc = requests.get(n).loc;
+                int next = requests.next(n);
+                if (env.getApplesAt(loc) == 0)
+                    requests.remove(n);
+                else
+                    LOG_DEBUG(LOG_HARVEST, "[%d] Location requests: (%d,%d). Remaining apples: %4.2f\n", t, loc.x, 
+                        loc.y, env.getApplesAt(loc));
+                n = next;
             }
             
-            // Simulate agents
-            for (int a = 0; a < NUM_AGENTS; ++a)
-                agents[a].makePlans(agents, bins, env, workers); // Each agent create plans
-            
+            // Simulate agents. Each agent creates plans; planning only reads the world, which stays unchanged
+            // until every agent is done, so the agents plan in parallel against the same state.
+            AutoAgent::collectIdleBins(world, idle); // Shared by every agent; tells them what changed
+            PlanTask planTask = { &agents, &world, &idle };
+            pool.run(planAgent, &planTask, NUM_AGENTS);
+            int planned = 0;
+            int cut = 0;
+            double maxPlanTime = 0;
             for (int a = 0; a < NUM_AGENTS; ++a) {
-                agents[a].selectPlan(agents, bins); // Each agent selects a plan (negotiate conflicts) with other agents
-                agents[a].takeAction(&binCounter, bins, requests, agents, repo, env, workers, t);
+                agents[a].printPlans();
+                if (agents[a].getPlanTime() < 0)
+                    continue;
+                ++planned;
+                cut += agents[a].wasPlanCut();
+                maxPlanTime = std::max(maxPlanTime, agents[a].getPlanTime());
             }
+            if (planFile != NULL)
+                fprintf(planFile, "%d,%d,%d,%.1f\n", t, planned, cut, maxPlanTime);
+            numPlanned += planned;
+            numCut += cut;
             
-            for (int r = 0; r < (int) requests.size(); ++r) {
-                if (isRequestFulfilled(requests[r].loc, bins)) {
-                    requests.erase(requests.begin() + r); // filter out fulfilled requests
-                    --r;
-                }
+            // Plans are bids; the auction resolves conflicts between agents
+            auction.clear(NUM_AGENTS);
+            for (int a = 0; a < NUM_AGENTS; ++a) {
+                const std::vector<Plan> &plans = agents[a].getPlans();
+                for (int p = 0; p < (int) plans.size(); ++p)
+                    auction.addBid(a, plans[p].binId, plans[p].value);
+            }
+            auction.assign();
+            if (auctionFile != NULL) {
+                fprintf(auctionFile, "%d,%d,%d,%.1f\n", t, auction.getNumBids(), auction.getNumAssigned(), 
+                    auction.getAssignTime() * 1e6);
             }
             
             for (int a = 0; a < NUM_AGENTS; ++a) {
-                Coordinate atmp = agents[a].getCurLoc();
-                fprintf(agentFiles[a], "%d,%d,%d\n", t, atmp.x, atmp.y);
+                agents[a].selectPlan(auction, world); // Each agent takes the bin it won
+                agents[a].takeAction(world, t);
             }
             
-            for (int b = 0; b < (int) bins.size(); ++b)
-                writeBinInfo("auto", t, bins[b]);
+            for (int r = requests.first(); r != -1; ) {
+                int next = requests.next(r);
+                if (requests.hasGroundBin(requests.get(r).loc))
+                    requests.remove(r); // filter out fulfilled requests (a bin is on the ground there)
+                r = next;
+            }
             
-            fprintf(repoFile, "%d,%d\n", t, (int) repo.size());
+            for (int a = 0; a < NUM_AGENTS; ++a)
+                agentLocs[a] = agents[a].getCurLoc();
+            traceStep(trace, t, agentLocs, bins, (int) repo.size());
             
             int appleLocCount = 0;
             if (env.getTotalApples(&appleLocCount) == 0 && repo.size() >= 80) {
-                printf("No more apples in orchard. Terminating simulation.\n");
+                LOG_INFO(LOG_SIM, "No more apples in orchard. Terminating simulation.\n");
                 break;
             }
         }
-        printf("+++++++++++++++ End of EPS = %d +++++++++++++++\n", eps);
-        printf("Total bins: %d\n", (int) repo.size());
+        LOG_INFO(LOG_SIM, "+++++++++++++++ End of EPS = %d +++++++++++++++\n", eps);
+        LOG_INFO(LOG_SIM, "Total bins: %d\n", (int) repo.size());
         int cellCount = 0;
-        printf("Remaining apples in orchard: %4.2f in %d locations\n", env.getTotalApples(&cellCount), cellCount);
+        float remaining = env.getTotalApples(&cellCount); // Before cellCount is read; it fills cellCount in
+        LOG_INFO(LOG_SIM, "Remaining apples in orchard: %4.2f in %d locations\n", remaining, cellCount);
+        if (summaryFile != NULL)
+            writeSummary(summaryFile, eps, (int) repo.size(), remaining, waits, workers.size());
+        if (PLAN_BUDGET > 0)
+            LOG_INFO(LOG_PLAN, "Planning budget cut %d of %d plans short.\n", numCut, numPlanned);
+        if (events)
+            LOG_INFO(LOG_SIM, "Event jumps skipped %d time steps.\n", numSkipped);
         // reset
-        workers.clear();
         workerGroups.clear();
         bins.clear();
         repo.clear();
@@ -441,31 +739,181 @@ void runAutonomous(const int NUM_AGENTS, const int NUM_LAYERS, const int TIME_LI
         for (int a = 0; a < NUM_AGENTS; ++a)
             agents[a].setCurLoc(Coordinate(0, agents[a].getCurLoc().y)); // reset agents location
     }
+    if (auctionFile != NULL)
+        fclose(auctionFile);
+    if (planFile != NULL)
+        fclose(planFile);
+    if (summaryFile != NULL)
+        fclose(summaryFile);
 }
 
-int main(int argc, char **argv)
+// Appends the file at path to fp; false if it cannot be read
+bool appendFile(FILE *fp, const char *path)
 {
-    //srand(time(NULL));
+    FILE *in = fopen(path, "r");
+    if (in == NULL)
+        return false;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, n, fp);
+    fclose(in);
+    return true;
+}
+
+/*
+ * Learning episodes on NUM_PROCS forked processes. In every round each process runs up to SYNC episodes from the 
+ * same learned states, logging under logs/<LOG_DIR>/eps<first episode>, and saves the states it ends with as its 
+ * shard. What the shards learned is then summed (or averaged) into the learned states in process order, so the 
+ * result depends only on the arguments, never on timing. The episode summaries are collected in 
+ * logs/<LOG_DIR>/summary.csv.
+ */
+void runParallel(const int NUM_AGENTS, const int NUM_LAYERS, const int TIME_LIMIT, const int MAX_EPS, 
+    const int NUM_ROWS, const int NUM_COLS, const char *YIELD_MAP, const int NUM_THREADS, bool optimal, 
+    const int PLAN_BUDGET, bool events, const int NUM_PROCS, const int SYNC, bool average, const int SEED, 
+    const char *LOG_DIR)
+{
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "logs/%s/shards", LOG_DIR);
+    makeDirs(path);
+    FILE *summaryFile = openSummary(LOG_DIR);
     
+    StateTable &states = AutoAgent::getStates();
+    for (int first = 0, round = 0; first < MAX_EPS; ++round) {
+        StateTable base = states;
+        std::vector<pid_t> pids;
+        std::vector<int> firsts;
+        int roundFirst = first;
+        logStop(); // Fork with no other thread running, so the children may start their own
+        for (int p = 0; p < NUM_PROCS && first < MAX_EPS; ++p) {
+            int n = std::min(SYNC, MAX_EPS - first);
+            pid_t pid = fork();
+            if (pid == 0) {
+                char dir[PATH_LEN];
+                snprintf(dir, sizeof(dir), "%s/eps%d", LOG_DIR, first);
+                snprintf(path, sizeof(path), "logs/%s/eps%d.txt", LOG_DIR, first);
+                if (freopen(path, "w", stdout) == NULL) {
+                    LOG_ERROR(LOG_LEARN, "Cannot create %s.\n", path);
+                    _exit(1);
+                }
+                logStart();
+                runAutonomous(NUM_AGENTS, NUM_LAYERS, TIME_LIMIT, n, true, NUM_ROWS, NUM_COLS, YIELD_MAP, NUM_THREADS, 
+                    optimal, PLAN_BUDGET, events, dir, first, SEED);
+                snprintf(path, sizeof(path), "logs/%s/shards/eps%d.st", LOG_DIR, first);
+                bool saved = states.save(path);
+                logFlush();
+                _exit(saved ? 0 : 1);
+            }
+            if (pid < 0) {
+                LOG_ERROR(LOG_LEARN, "Cannot start a process for episode %d.\n", first);
+                exit(1);
+            }
+            pids.push_back(pid);
+            firsts.push_back(first);
+            first += n;
+        }
+        logStart();
+        
+        for (int p = 0; p < (int) pids.size(); ++p) {
+            int status;
+            if (waitpid(pids[p], &status, 0) != pids[p] || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                LOG_ERROR(LOG_LEARN, "Episodes from %d failed; see logs/%s/eps%d.txt.\n", firsts[p], LOG_DIR, 
+                    firsts[p]);
+                exit(1);
+            }
+        }
+        
+        float weight = average ? 1.0f / pids.size() : 1.0f;
+        StateTable shard;
+        for (int p = 0; p < (int) pids.size(); ++p) {
+            snprintf(path, sizeof(path), "logs/%s/shards/eps%d.st", LOG_DIR, firsts[p]);
+            if (!shard.load(path)) {
+                LOG_ERROR(LOG_LEARN, "Cannot load shard %s.\n", path);
+                exit(1);
+            }
+            states.mergeShard(base, shard, weight);
+            remove(path);
+            snprintf(path, sizeof(path), "logs/%s/eps%d/summary.csv", LOG_DIR, firsts[p]);
+            if (summaryFile != NULL && !appendFile(summaryFile, path))
+                LOG_WARN(LOG_SIM, "Cannot read %s.\n", path);
+        }
+        LOG_INFO(LOG_LEARN, "Round %d: episodes %d-%d on %d processes, %d learned states.\n", round, roundFirst, 
+            first - 1, (int) pids.size(), states.size());
+    }
+    if (summaryFile != NULL)
+        fclose(summaryFile);
+}
+
+// One -base or -auto run as given on the command line; returns the exit code
+int runCommand(int argc, char **argv)
+{
     int timeLimit = 10; // Default time limit
     int numAgents = DEFAULT_NUM_AGENTS;
+    int numRows = ORCH_ROWS;
+    int numCols = ORCH_COLS;
+    char *yieldMap = NULL;
+    bool events = false;
+    const char *logDir = NULL;
     
     if (strcmp(argv[1], "-base") == 0) {
         for (int i = 2; i < argc; ++i) {
-            if (argv[i][1] == 'a')
+            if (strcmp(argv[i], "-events") == 0)
+                events = true;
+            else if (strncmp(argv[i], "-dir=", 5) == 0)
+                logDir = parseArgStr(argv[i]);
+            else if (argv[i][1] == 'a')
                 numAgents = parseArgInt(argv[i]);
             else if (argv[i][1] == 't')
                 timeLimit = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'r')
+                numRows = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'c')
+                numCols = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'y')
+                yieldMap = parseArgStr(argv[i]);
         }
-        printf("---------- Starting simulation with baseline algorithm ----------\n");
-        runBase(numAgents, timeLimit);
+        if (logDir == NULL)
+            logDir = "base";
+        if (!checkLogDir(logDir, MAX_DIR_LEN))
+            return 1;
+        LOG_INFO(LOG_SIM, "---------- Starting simulation with baseline algorithm ----------\n");
+        if (events)
+            LOG_INFO(LOG_SIM, "The clock jumps between events.\n");
+        runBase(numAgents, timeLimit, numRows, numCols, yieldMap, events, logDir);
     } else if (strcmp(argv[1], "-auto") == 0) {
         int numEps = 1;
         int numLayers = DEFAULT_NUM_LAYERS;
+        int numThreads = 1;
         bool learn = false;
+        bool optimal = false;
+        int planBudget = 0;
+        char *loadPath = NULL;
+        char *savePath = NULL;
+        int numProcs = 0;
+        int sync = 0;
+        bool average = false;
+        int seed = -1;
         for (int i = 2; i < argc; ++i) {
             if (strcmp(argv[i], "-learn") == 0)
                 learn = true;
+            else if (strcmp(argv[i], "-optimal") == 0)
+                optimal = true;
+            else if (strncmp(argv[i], "-load=", 6) == 0)
+                loadPath = parseArgStr(argv[i]);
+            else if (strncmp(argv[i], "-save=", 6) == 0)
+                savePath = parseArgStr(argv[i]);
+            else if (strncmp(argv[i], "-sync=", 6) == 0)
+                sync = parseArgInt(argv[i]);
+            else if (strncmp(argv[i], "-seed=", 6) == 0)
+                seed = parseArgInt(argv[i]);
+            else if (strcmp(argv[i], "-avg") == 0)
+                average = true;
+            else if (strcmp(argv[i], "-events") == 0)
+                events = true;
+            else if (strncmp(argv[i], "-dir=", 5) == 0)
+                logDir = parseArgStr(argv[i]);
+            else if (argv[i][1] == 'p')
+                numProcs = parseArgInt(argv[i]);
             else if (argv[i][1] == 'a')
                 numAgents = parseArgInt(argv[i]);
             else if (argv[i][1] == 'l')
@@ -474,17 +922,233 @@ int main(int argc, char **argv)
                 timeLimit = parseArgInt(argv[i]);
             else if (argv[i][1] == 'e')
                 numEps = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'j')
+                numThreads = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'b')
+                planBudget = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'r')
+                numRows = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'c')
+                numCols = parseArgInt(argv[i]);
+            else if (argv[i][1] == 'y')
+                yieldMap = parseArgStr(argv[i]);
         }
-        printf("---------- Starting simulation with autonomous agents ----------\n");
+        if (logDir == NULL)
+            logDir = "auto";
+        if (!checkLogDir(logDir, MAX_DIR_LEN))
+            return 1;
+        LOG_INFO(LOG_SIM, "---------- Starting simulation with autonomous agents ----------\n");
         if (learn)
-            printf("Learning is used to select location request.\n");
+            LOG_INFO(LOG_LEARN, "Learning is used to select location request.\n");
         if (!learn)
             numEps = 1;
-        runAutonomous(numAgents, numLayers, timeLimit, numEps, learn);
+        if (optimal)
+            LOG_INFO(LOG_PLAN, "Bins are assigned to agents optimally.\n");
+        if (planBudget > 0)
+            LOG_INFO(LOG_PLAN, "Agents plan within %d us per time step.\n", planBudget);
+        if (events)
+            LOG_INFO(LOG_SIM, "The clock jumps between events.\n");
+        if (loadPath != NULL) {
+            if (!AutoAgent::getStates().load(loadPath)) {
+                LOG_ERROR(LOG_LEARN, "Cannot load learned states from %s.\n", loadPath);
+                return 1;
+            }
+            LOG_INFO(LOG_LEARN, "Loaded %d learned states from %s.\n", AutoAgent::getStates().size(), loadPath);
+        }
+        if (learn && numProcs > 0) {
+            if (sync <= 0)
+                sync = (numEps + numProcs - 1) / numProcs;
+            LOG_INFO(LOG_LEARN, "Learning episodes run on %d processes; shards are %s every %d episodes.\n", numProcs, 
+                average ? "averaged" : "summed", sync);
+            runParallel(numAgents, numLayers, timeLimit, numEps, numRows, numCols, yieldMap, numThreads, optimal, 
+                planBudget, events, numProcs, sync, average, seed, logDir);
+        } else {
+            runAutonomous(numAgents, numLayers, timeLimit, numEps, learn, numRows, numCols, yieldMap, numThreads, 
+                optimal, planBudget, events, logDir, 0, seed);
+        }
+        if (savePath != NULL) {
+            if (!AutoAgent::getStates().save(savePath)) {
+                LOG_ERROR(LOG_LEARN, "Cannot save learned states to %s.\n", savePath);
+                return 1;
+            }
+            LOG_INFO(LOG_LEARN, "Saved %d learned states to %s.\n", AutoAgent::getStates().size(), savePath);
+        }
     }
     
     return 0;
 }
 
+/*
+ * Parameter sweep. Every line of the grid file lists alternatives for one argument ("-" for leaving it out, 
+ * # starts a comment), and every combination of one alternative per line is a run, so a grid of 
+ *     -base -auto
+ *     -a=2 -a=4 -a=8
+ *     -t=500
+ *     -seed=1 -seed=2
+ * makes 12 runs. Every run is started as a new process of this program (prog), up to NUM_PROCS at a time, so a 
+ * run with -p forks its own learning processes. Run k logs under logs/<LOG_DIR>/run<k> and prints to 
+ * logs/<LOG_DIR>/run<k>.txt; the summary of its last episode goes to logs/<LOG_DIR>/results.csv.
+ */
+int runSweep(const char *prog, const char *GRID, const int NUM_PROCS, const char *LOG_DIR)
+{
+    FILE *fp = fopen(GRID, "r");
+    if (fp == NULL) {
+        LOG_ERROR(LOG_SIM, "Cannot open grid file %s.\n", GRID);
+        return 1;
+    }
+    std::vector<std::vector<std::string> > axes;
+    char line[4096];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+        std::vector<std::string> values;
+        for (char *tok = strtok(line, " \t\r\n"); tok != NULL; tok = strtok(NULL, " \t\r\n"))
+            values.push_back(tok);
+        if (!values.empty())
+            axes.push_back(values);
+    }
+    fclose(fp);
+    
+    // Run k takes alternative (k / stride) % count of every line, the last line changing fastest
+    int numRuns = 1;
+    for (int i = 0; i < (int) axes.size(); ++i)
+        numRuns *= (int) axes[i].size();
+    std::vector<std::vector<std::string> > runs(numRuns);
+    for (int k = 0; k < numRuns; ++k) {
+        std::vector<std::string> &args = runs[k];
+        args.push_back(prog);
+        args.push_back(""); // -base or -auto
+        for (int i = (int) axes.size() - 1, rest = k; i >= 0; --i) {
+            const std::string &v = axes[i][rest % axes[i].size()];
+            rest /= (int) axes[i].size();
+            if (v == "-base" || v == "-auto")
+                args[1] = v;
+            else if (v != "-")
+                args.insert(args.begin() + 2, v);
+        }
+        if (args[1].empty()) {
+            LOG_ERROR(LOG_SIM, "Run %d of %s has neither -base nor -auto.\n", k, GRID);
+            return 1;
+        }
+        char dir[PATH_LEN];
+        snprintf(dir, sizeof(dir), "-dir=%s/run%d", LOG_DIR, k);
+        args.push_back(dir);
+    }
+    
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "logs/%s", LOG_DIR);
+    if (!makeDirs(path)) {
+        LOG_ERROR(LOG_SIM, "Cannot create %s.\n", path);
+        return 1;
+    }
+    int numProcs = (NUM_PROCS > 0) ? NUM_PROCS : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    LOG_INFO(LOG_SIM, "---------- Sweeping %d runs on %d processes ----------\n", numRuns, numProcs);
+    
+    std::vector<pid_t> pids(numRuns, 0);
+    std::vector<double> seconds(numRuns, 0);
+    std::vector<bool> failed(numRuns, false);
+    int started = 0;
+    int running = 0;
+    while (started < numRuns || running > 0) {
+        if (started < numRuns && running < numProcs) {
+            int k = started++;
+            std::vector<char *> argv;
+            for (int i = 0; i < (int) runs[k].size(); ++i)
+                argv.push_back(&runs[k][i][0]);
+            argv.push_back(NULL);
+            snprintf(path, sizeof(path), "logs/%s/run%d.txt", LOG_DIR, k);
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            pid_t pid;
+            int err = posix_spawnp(&pid, prog, &actions, NULL, &argv[0], environ);
+            posix_spawn_file_actions_destroy(&actions);
+            if (err != 0) {
+                LOG_ERROR(LOG_SIM, "Cannot start run %d: %s.\n", k, strerror(err));
+                failed[k] = true;
+                continue;
+            }
+            pids[k] = pid;
+            seconds[k] = planClock();
+            ++running;
+            continue;
+        }
+        
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        int k = (int) (std::find(pids.begin(), pids.end(), pid) - pids.begin());
+        if (k == numRuns)
+            continue;
+        --running;
+        seconds[k] = planClock() - seconds[k];
+        failed[k] = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        if (failed[k])
+            LOG_WARN(LOG_SIM, "Run %d failed; see logs/%s/run%d.txt.\n", k, LOG_DIR, k);
+        else
+            LOG_INFO(LOG_SIM, "Run %d done in %.2f s.\n", k, seconds[k]);
+    }
+    
+    // One row per run, in run order; the fields of a failed run are left empty
+    char resultsPath[PATH_LEN];
+    snprintf(resultsPath, sizeof(resultsPath), "logs/%s/results.csv", LOG_DIR);
+    FILE *results = fopen(resultsPath, "w");
+    if (results == NULL) {
+        LOG_ERROR(LOG_SIM, "Cannot create %s.\n", resultsPath);
+        return 1;
+    }
+    fprintf(results, "run,arguments,episodes,total bins,remaining apples,mean human wait,mean bin wait,seconds\n");
+    int numFailed = 0;
+    for (int k = 0; k < numRuns; ++k) {
+        std::string args = runs[k][1];
+        for (int i = 2; i < (int) runs[k].size() - 1; ++i)
+            args += " " + runs[k][i];
+        char last[256] = "";
+        char row[256];
+        snprintf(path, sizeof(path), "logs/%s/run%d/summary.csv", LOG_DIR, k);
+        FILE *summary = failed[k] ? NULL : fopen(path, "r");
+        if (summary != NULL) {
+            while (fgets(row, sizeof(row), summary) != NULL)
+                strcpy(last, row);
+            fclose(summary);
+        }
+        int eps;
+        int totalBins;
+        float remaining;
+        float humanWait;
+        float binWait;
+        if (sscanf(last, "%d,%d,%f,%f,%f", &eps, &totalBins, &remaining, &humanWait, &binWait) == 5) {
+            fprintf(results, "%d,%s,%d,%d,%.2f,%.2f,%.2f,%.2f\n", k, args.c_str(), eps + 1, totalBins, remaining, 
+                humanWait, binWait, seconds[k]);
+        } else {
+            fprintf(results, "%d,%s,,,,,,\n", k, args.c_str());
+            ++numFailed;
+        }
+    }
+    fclose(results);
+    LOG_INFO(LOG_SIM, "%d of %d runs summarized in %s.\n", numRuns - numFailed, numRuns, resultsPath);
+    return (numFailed > 0) ? 1 : 0;
+}
 
-
+int main(int argc, char **argv)
+{
+    //srand(time(NULL));
+    logStart();
+    
+    if (argc > 1 && strncmp(argv[1], "-sweep=", 7) == 0) {
+        int numProcs = 0;
+        const char *logDir = "sweep";
+        for (int i = 2; i < argc; ++i) {
+            if (strncmp(argv[i], "-dir=", 5) == 0)
+                logDir = parseArgStr(argv[i]);
+            else if (argv[i][1] == 'p')
+                numProcs = parseArgInt(argv[i]);
+        }
+        if (!checkLogDir(logDir, MAX_DIR_LEN - 16)) // Room for the run<k> directories
+            return 1;
+        return runSweep(argv[0], parseArgStr(argv[1]), numProcs, logDir);
+    }
+    return runCommand(argc, argv);
+}
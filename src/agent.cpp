@@ -5,10 +5,12 @@
 #include <cfloat>
 #include "params.hpp"
 #include "agent.hpp"
+#include "log.hpp"
 
-Agent::Agent(int i, Coordinate c)
+Agent::Agent(int i, Coordinate c, const Orchard &env)
 {
     id = i;
+    oracle = &env.getDistance();
     curLoc = c;
     targetLoc = Coordinate(0, 0);
     curBinId = -1;
@@ -21,21 +23,14 @@ Agent::~Agent()
     targetBinId = -1;
 }
 
-int Agent::getBinIndexById(std::vector<AppleBin> bins, int id)
+void Agent::getIdleBins(const AgentWorld &world, std::vector<int> &idleBins) const
 {
-    for (int b = 0; b < (int) bins.size(); ++b) {
-        if (bins[b].id == id)
-            return b;
-    }
-    return -1;
-}
-
-std::vector<int> Agent::getIdleBins(std::vector<AppleBin> bins, std::vector<Agent> agents)
-{
-    std::vector<int> idleBins;
+    const BinStore &bins = world.getBins();
+    ConstSpan<Agent> agents = world.getAgents();
+    idleBins.clear();
     
     if (bins.size() == 0)
-        return idleBins;
+        return;
     
     for (int b = 0; b < (int) bins.size(); ++b) {
         if (bins[b].onGround)
@@ -47,10 +42,10 @@ std::vector<int> Agent::getIdleBins(std::vector<AppleBin> bins, std::vector<Agen
     for (int a = 0; a < (int) agents.size(); ++a) {
         if (agents[a].id == id)
             continue;
-        int bIdx = getBinIndexById(bins, agents[a].curBinId);
+        int bIdx = bins.indexOf(agents[a].curBinId);
         /*if (bIdx != -1)
             idleBins[bIdx] = -1;*/
-        int stepCount = getStepCount(agents[a].curLoc, agents[a].targetLoc);
+        int stepCount = oracle->getStepCount(agents[a].curLoc, agents[a].targetLoc);
         if (bIdx != -1 && stepCount == 0) {
             idleBins[bIdx] = bIdx;
         }
@@ -59,37 +54,66 @@ std::vector<int> Agent::getIdleBins(std::vector<AppleBin> bins, std::vector<Agen
     for (int a = 0; a < (int) agents.size(); ++a) {
         if (agents[a].id == id)
             continue;
-        int tIdx = getBinIndexById(bins, agents[a].targetBinId);
+        int tIdx = bins.indexOf(agents[a].targetBinId);
         if (tIdx != -1)
             idleBins[tIdx] = -1;
     }
     
-    for (int i = 0; i < (int) idleBins.size(); ++i) {
-        if (idleBins[i] == -1) {
-            idleBins.erase(idleBins.begin() + i);
-            --i;
+    idleBins.erase(std::remove(idleBins.begin(), idleBins.end(), -1), idleBins.end());
+}
+
+bool Agent::isQuiet(const AgentWorld &world, std::vector<Trip> &trips)
+{
+    const BinStore &bins = world.getBins();
+    const RequestQueue &requests = world.getRequests();
+    ConstSpan<Agent> agents = world.getAgents();
+    std::vector<int> idleBins;
+    trips.assign(agents.size(), Trip());
+    for (int a = 0; a < (int) agents.size(); ++a) {
+        const Agent &ag = agents[a];
+        Trip &trip = trips[a];
+        trip.dst = ag.curLoc;
+        if (ag.targetBinId == -1 && ag.curBinId == -1) { // Idle while there is nothing to pick up or bring a bin to
+            if (requests.size() > 0)
+                return false;
+            ag.getIdleBins(world, idleBins);
+            if (!idleBins.empty())
+                return false;
+            continue;
+        }
+        int cIdx = bins.indexOf(ag.curBinId);
+        trip.bin = cIdx;
+        if (cIdx != -1 && bins[cIdx].capacity == 0) { // Clears the requests wherever it carries an empty bin
+            if (requests.find(bins[cIdx].loc) != -1)
+                return false;
+            trip.clearsRequests = true;
+        }
+        int speed = (cIdx != -1 && bins[cIdx].capacity > 0) ? AGENT_SPEED_L : AGENT_SPEED_H; // As move picks it
+        if (ag.curBinId == ag.targetBinId || (cIdx != -1 && bins[cIdx].capacity >= BIN_CAPACITY)) {
+            if (ag.curLoc.x == 0) // Delivers the bin
+                return false;
+            trip.dst = Coordinate(0, ag.curLoc.y);
+            trip.speed = speed;
+        } else if (ag.curLoc.x != ag.targetLoc.x || ag.curLoc.y != ag.targetLoc.y) {
+            trip.dst = ag.targetLoc;
+            trip.speed = speed;
+        } else { // Waits unless it drops its bin here or the target bin is full
+            int tIdx = bins.indexOf(ag.targetBinId);
+            if (tIdx == -1 || round(bins[tIdx].capacity) >= BIN_CAPACITY)
+                return false;
         }
     }
-    
-    return idleBins;
+    return true;
 }
 
-int Agent::getStepCount(Coordinate src, Coordinate dst)
+void Agent::followTrip(AgentWorld &world, const Trip &trip, int ticks)
 {
-    int initStep = 0;
-    if (!isLocationValid(src) || !isLocationValid(dst))
-        return 0;
-    
-    if (src.y != dst.y) {
-        int leftStep = src.x - 0;
-        int rightStep = ORCH_COLS - 1 - src.x;
-        initStep = (leftStep <= rightStep) ? leftStep : rightStep;
-    }
-    
-    return initStep + abs(src.x - dst.x) + abs(src.y - dst.y);
+    curLoc = oracle->advance(curLoc, trip.dst, trip.speed * ticks);
+    if (trip.bin != -1)
+        world.moveBin(trip.bin, curLoc);
 }
 
-int Agent::getFirstEstFullBin(std::vector<int> indexes, std::vector<AppleBin> bins)
+int Agent::getFirstEstFullBin(const std::vector<int> &indexes, const BinStore &bins)
 {
     if (indexes.size() == 1)
         return indexes[0];
@@ -98,8 +122,13 @@ int Agent::getFirstEstFullBin(std::vector<int> indexes, std::vector<AppleBin> bi
     float maxEstCap = 0;
     float minDist = FLT_MAX;
     
+    binLocs.resize(indexes.size());
+    for (int i = 0; i < (int) indexes.size(); ++i)
+        binLocs[i] = bins[indexes[i]].loc;
+    oracle->getStepCounts(curLoc, binLocs, binSteps);
+    
     for (int i = 0; i < (int) indexes.size(); ++i) {
-        float dist = getStepCount(curLoc, bins[indexes[i]].loc);
+        float dist = binSteps[i];
         float estTime = dist / AGENT_SPEED_L;
         float estIncrease = estTime * bins[indexes[i]].fillRate;
         float estCap = bins[indexes[i]].capacity + estIncrease;
@@ -114,17 +143,22 @@ int Agent::getFirstEstFullBin(std::vector<int> indexes, std::vector<AppleBin> bi
     return maxBinIdx;
 }
 
-int Agent::getClosestFullBin(std::vector<int> indexes, std::vector<AppleBin> bins)
+int Agent::getClosestFullBin(const std::vector<int> &indexes, const BinStore &bins)
 {
     if (indexes.size() == 0)
         return -1;
     
+    binLocs.resize(indexes.size());
+    for (int b = 0; b < (int) indexes.size(); ++b)
+        binLocs[b] = bins[indexes[b]].loc;
+    oracle->getStepCounts(curLoc, binLocs, binSteps);
+    
     int minBinIdx = -1;
     int minDist = INT_MAX;
     for (int b = 0; b < (int) indexes.size(); ++b) {
         if (bins[indexes[b]].capacity < BIN_CAPACITY)
             continue;
-        int dist = getStepCount(curLoc, bins[indexes[b]].loc);
+        int dist = binSteps[b];
         if (dist < minDist) {
             minBinIdx = indexes[b];
             minDist = dist;
@@ -133,12 +167,7 @@ int Agent::getClosestFullBin(std::vector<int> indexes, std::vector<AppleBin> bin
     return minBinIdx;
 }
 
-bool Agent::isLocationValid(Coordinate loc)
-{
-    return (loc.x >= 0 && loc.x < ORCH_COLS && loc.y >= 0 && loc.y < ORCH_ROWS);
-}
-
-void Agent::move(AppleBin curBin)
+void Agent::move(const AppleBin &curBin)
 {
     // Check if all locations are valid
     if (!isLocationValid(curLoc) || !isLocationValid(targetLoc))
@@ -148,46 +177,10 @@ void Agent::move(AppleBin curBin)
     if (curBinId != -1 && curBin.capacity > 0)
         speed = AGENT_SPEED_L;
     
-    for (int s = 0; s < speed; ++s) {
-        if (targetLoc.x == 0) { // Target location is the repo
-            if (curLoc.x != targetLoc.x)
-                curLoc.x = (curLoc.x - 1 <= targetLoc.x) ? targetLoc.x : curLoc.x - 1; // Move left
-        } else {
-            if (curLoc.y == targetLoc.y) {
-                if (targetLoc.x > curLoc.x)
-                    curLoc.x = (curLoc.x + 1 >= targetLoc.x) ? targetLoc.x : curLoc.x + 1; // Move right
-                else
-                    curLoc.x = (curLoc.x - 1 <= targetLoc.x) ? targetLoc.x : curLoc.x - 1; // Move left
-            } else { // Need to travel between rows
-                if (curLoc.x == 0 || curLoc.x == ORCH_COLS - 1) { // At left/rightmost column; can travel between rows
-                    if (targetLoc.y > curLoc.y)
-                        curLoc.y = (curLoc.y + 1 >= targetLoc.y) ? targetLoc.y : curLoc.y + 1; // Move down
-                    else
-                        curLoc.y = (curLoc.y - 1 <= targetLoc.y) ? targetLoc.y : curLoc.y - 1; // Move up
-                } else {
-                    int leftDist = curLoc.x;
-                    int rightDist = ORCH_COLS - 1 - curLoc.x;
-                    if (leftDist < rightDist) // Travel between rows through the leftmost column
-                        curLoc.x = (curLoc.x - 1 <= targetLoc.x) ? curLoc.x - 1 : targetLoc.x; // Move left
-                    else
-                        curLoc.x = (curLoc.x + 1 >= targetLoc.x) ? curLoc.x + 1 : targetLoc.x; // Move right
-                }
-            }
-        }
-    } // end for
-}
-
-void Agent::filterRegisteredLocations(std::vector<LocationRequest> &requests, Coordinate loc)
-{
-    for (int n = 0; n < (int) requests.size(); ++n) {
-        if (requests[n].loc.x == loc.x && requests[n].loc.y == loc.y) {
-            requests.erase(requests.begin() + n);
-            --n;
-        }
-    }
+    curLoc = oracle->advance(curLoc, targetLoc, speed);
 }
 
-int Agent::checkIfCarryingBin(std::vector<Agent> &agents, std::vector<AppleBin> &bins, Coordinate loc)
+int Agent::checkIfCarryingBin(ConstSpan<Agent> agents, Coordinate loc)
 {
     for (int a = 0; a < (int) agents.size(); ++a) {
         Coordinate tmp = agents[a].getTargetLoc();
@@ -203,12 +196,13 @@ int Agent::checkIfCarryingBin(std::vector<Agent> &agents, std::vector<AppleBin>
     return -1;
 }
 
-int Agent::getBinIndexByLocation(std::vector<Agent> &agents, std::vector<AppleBin> &bins, Coordinate loc)
+int Agent::getBinIndexByLocation(const AgentWorld &world, Coordinate loc)
 {
+    const BinStore &bins = world.getBins();
     for (int b = 0; b < (int) bins.size(); ++b) {
         // bug fixed here. If the bin on ground is not full, return b.
         if (bins[b].loc.x == loc.x && bins[b].loc.y == loc.y) {
-            int carry = checkIfCarryingBin(agents, bins, loc);
+            int carry = checkIfCarryingBin(world.getAgents(), loc);
             if (carry != -1) {
                 return b;
             }
@@ -217,29 +211,31 @@ int Agent::getBinIndexByLocation(std::vector<Agent> &agents, std::vector<AppleBi
     return -1;
 }
 
-Coordinate Agent::selectNewLocation(std::vector<Agent> &agents, std::vector<AppleBin> &bins, 
-    std::vector<LocationRequest> &requests)
+Coordinate Agent::selectNewLocation(const AgentWorld &world)
 {
-    for (int n = 0; n < (int) requests.size(); ++n) {
-        int idx = getBinIndexByLocation(agents, bins, requests[n].loc);
+    const RequestQueue &requests = world.getRequests();
+    for (int n = requests.first(); n != -1; n = requests.next(n)) {
+        int idx = getBinIndexByLocation(world, requests.get(n).loc);
         if (idx == -1) {
-            return requests[n].loc;
+            return requests.get(n).loc;
         }
     }
     return Coordinate(-1,-1);
 }
 
-bool Agent::agentWithNewBin(std::vector<Agent> agents, std::vector<AppleBin> bins, Coordinate loc)
+bool Agent::agentWithNewBin(const AgentWorld &world, Coordinate loc)
 {
+    const BinStore &bins = world.getBins();
+    ConstSpan<Agent> agents = world.getAgents();
     for (int i = 0; i < (int) agents.size(); ++i) {
-        int idx = getBinIndexById(bins, agents[i].curBinId);
+        int idx = bins.indexOf(agents[i].curBinId);
         if (idx != -1 && bins[idx].capacity == 0 && agents[i].targetLoc.x == loc.x && agents[i].targetLoc.y == loc.y)
             return true;
     }
     return false;
 }
 
-int Agent::getBinIndexByLocation(std::vector<AppleBin> bins, Coordinate loc)
+int Agent::getBinIndexByLocation(const BinStore &bins, Coordinate loc)
 {
     for (int i = 0; i < (int) bins.size(); ++i) {
         if (bins[i].loc.x == loc.x && bins[i].loc.y == loc.y)
@@ -248,14 +244,17 @@ int Agent::getBinIndexByLocation(std::vector<AppleBin> bins, Coordinate loc)
     return -1;
 }
 
-void Agent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector<AppleBin> &repo, 
-    std::vector<Agent> &agents, Orchard env, std::vector<LocationRequest> &requests)
+void Agent::takeAction(AgentWorld &world)
 {
+    const BinStore &bins = world.getBins();
+    const Orchard &env = world.getOrchard();
+    const RequestQueue &requests = world.getRequests();
     if (targetBinId == -1 && curBinId == -1) { // Agent is idle
         // Find an idle bin to be picked up
-        std::vector<int> idleBins = getIdleBins(bins, agents);
+        std::vector<int> &idleBins = idleBinScratch;
+        getIdleBins(world, idleBins);
         if (idleBins.size() > 0) { // There are idle bins
-            printf("A%d(%d,%d) sees %d idle bins.\n", id, curLoc.x, curLoc.y, (int) idleBins.size());
+            LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) sees %d idle bins.\n", id, curLoc.x, curLoc.y, (int) idleBins.size());
             // Choose an existing bin to pick up
             int tmpIdx = getClosestFullBin(idleBins, bins);
             if (tmpIdx != -1) {
@@ -270,124 +269,125 @@ void Agent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector
                 }
             }
             if (targetBinId != -1) {
-                int tIdx = getBinIndexById(bins, targetBinId);
+                int tIdx = bins.indexOf(targetBinId);
                 if (env.getApplesAt(bins[tIdx].loc) - BIN_CAPACITY > 0 && curLoc.x == 0) {
-                    if (!agentWithNewBin(agents, bins, bins[tIdx].loc)) {
-                        curBinId = (*binCounter)++;
-                        printf("A%d takes a new bin B%d to (%d,%d). Apples: %4.2f\n", id, curBinId, targetLoc.x, 
-                            targetLoc.y, env.getApplesAt(bins[tIdx].loc));
-                        bins.push_back(AppleBin(curBinId, curLoc.x, curLoc.y));
-                        filterRegisteredLocations(requests, targetLoc);
+                    if (!agentWithNewBin(world, bins[tIdx].loc)) {
+                        curBinId = world.createBin(curLoc);
+                        LOG_DEBUG(LOG_AGENT, "A%d takes a new bin B%d to (%d,%d). Apples: %4.2f\n", id, curBinId, 
+                            targetLoc.x, targetLoc.y, env.getApplesAt(bins[tIdx].loc));
+                        world.removeRequests(targetLoc);
                     }
                 }
-                int cIdx = getBinIndexById(bins, curBinId);
+                int cIdx = bins.indexOf(curBinId);
                 move(bins[cIdx]);
                 if (cIdx != -1)
-                    bins[cIdx].loc = curLoc;
-                printf("A%d(%d,%d) moves to pick up B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, targetBinId, 
-                    targetLoc.x, targetLoc.y);
+                    world.moveBin(cIdx, curLoc);
+                LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) moves to pick up B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, 
+                    targetBinId, targetLoc.x, targetLoc.y);
             }
         } else if (requests.size() > 0) { // There's a new harvest location without bin
-            printf("A%d sees %d new locations without bins.\n", id, (int) requests.size());
-            Coordinate newLoc = selectNewLocation(agents, bins, requests);
+            LOG_DEBUG(LOG_AGENT, "A%d sees %d new locations without bins.\n", id, (int) requests.size());
+            Coordinate newLoc = selectNewLocation(world);
             if (newLoc.x != -1 && newLoc.y != -1) { // There's a registered location without any bin
                 if (curLoc.x != 0 && curBinId == -1){ // Agent is in orchard and carries no bin
                      targetLoc = getRepoLocation();
-                     int cIdx = getBinIndexById(bins, curBinId);
+                     int cIdx = bins.indexOf(curBinId);
                      move(bins[cIdx]);
-                     printf("A%d sees %d new locations without bins, moves back to repo to get a new bin. (%d,%d)\n", 
-                        id, (int) requests.size(),curLoc.x,curLoc.y);
+                     LOG_DEBUG(LOG_AGENT, "A%d sees %d new locations without bins, moves back to repo to get a new "
+                         "bin. (%d,%d)\n", id, (int) requests.size(), curLoc.x, curLoc.y);
                 } else {
-                    for (int r = 0; r < (int) requests.size(); ++r) {
-                        if (agentWithNewBin(agents, bins, requests[r].loc))
+                    for (int r = requests.first(); r != -1; r = requests.next(r)) {
+                        Coordinate rLoc = requests.get(r).loc;
+                        if (agentWithNewBin(world, rLoc))
                             continue;
-                        if (env.getApplesAt(requests[r].loc) <= 0)
+                        if (env.getApplesAt(rLoc) <= 0)
                             continue;
-                        int rIdx = getBinIndexByLocation(bins, requests[r].loc);
+                        int rIdx = getBinIndexByLocation(bins, rLoc);
                         if (rIdx != -1 && env.getApplesAt(bins[rIdx].loc) - BIN_CAPACITY <= 0)
                             continue;
-                        curBinId = (*binCounter)++;
-                        bins.push_back(AppleBin(curBinId, curLoc.x, curLoc.y));
+                        curBinId = world.createBin(curLoc);
                         targetBinId = -1;
-                        targetLoc = requests[r].loc;
-                        printf("A%d takes a new bin B%d to (%d,%d). Apples: %4.2f / %4.2f\n", id, curBinId, targetLoc.x, 
-                            targetLoc.y, env.getApplesAt(bins[rIdx].loc), BIN_CAPACITY);
-                        requests.erase(requests.begin() + r);
-                        int cIdx = getBinIndexById(bins, curBinId);
+                        targetLoc = rLoc;
+                        float binApples = (rIdx != -1) ? env.getApplesAt(bins[rIdx].loc) : 0; // No bin there yet
+                        LOG_DEBUG(LOG_AGENT, "A%d takes a new bin B%d to (%d,%d). Apples: %4.2f / %4.2f\n", id, 
+                            curBinId, targetLoc.x, targetLoc.y, binApples, BIN_CAPACITY);
+                        world.removeRequest(r);
+                        int cIdx = bins.indexOf(curBinId);
                         move(bins[cIdx]);
                         if (cIdx != -1)
-                            bins[cIdx].loc = curLoc;
-                        printf("A%d(%d,%d) carries new bin B%d to (%d,%d).\n", id, curLoc.x, curLoc.y, bins[cIdx].id, 
-                            targetLoc.x, targetLoc.y);
+                            world.moveBin(cIdx, curLoc);
+                        LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) carries new bin B%d to (%d,%d).\n", id, curLoc.x, curLoc.y, 
+                            bins[cIdx].id, targetLoc.x, targetLoc.y);
                         break;
                     }
                 }
             } else {
-                printf("Another agent is taking care of that. A%d (%d,%d) is idle.\n", id, curLoc.x, curLoc.y);
+                LOG_DEBUG(LOG_AGENT, "Another agent is taking care of that. A%d (%d,%d) is idle.\n", id, curLoc.x, 
+                    curLoc.y);
             }
         } else {
-            printf("A%d(%d,%d) is idle.\n", id, curLoc.x, curLoc.y);
+            LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) is idle.\n", id, curLoc.x, curLoc.y);
         }
     } else {
         /* Agent is not idle (i.e. moving towards a bin or waiting for a bin) */
-        int curBinIdx = getBinIndexById(bins, curBinId);
+        int curBinIdx = bins.indexOf(curBinId);
         if (curBinId != -1 && bins[curBinIdx].capacity == 0) // Agent is carrying an empty bin to a location
-            filterRegisteredLocations(requests, bins[curBinIdx].loc); // If the target location is in the new location list, remove it
+            world.removeRequests(bins[curBinIdx].loc); // If the target location is in the new location list, remove it
         if (curBinId == targetBinId || (curBinId != -1 && bins[curBinIdx].capacity >= BIN_CAPACITY)) {
             // Agent is carrying the target bin, go to repo (column 0 at every row)
             targetLoc = getRepoLocation();
-            int cIdx = getBinIndexById(bins, curBinId);
+            int cIdx = bins.indexOf(curBinId);
             move(bins[cIdx]);
             if (cIdx != -1)
-                bins[cIdx].loc = curLoc;
-            printf("A%d moves to (%d,%d). Target: (%d,%d). Destination: REPO.\n", id, curLoc.x, curLoc.y, 
+                world.moveBin(cIdx, curLoc);
+            LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). Target: (%d,%d). Destination: REPO.\n", id, curLoc.x, curLoc.y, 
                 targetLoc.x, targetLoc.y);
         } else { // Agent is on the way to pick up the target bin; it may or may not be carrying an empty bin
             if (curLoc.x == targetLoc.x && curLoc.y == targetLoc.y) { // Arrived at target location
-                printf("A%d arrives at target (%d,%d). CurBinId: %d\n", id, targetLoc.x, targetLoc.y, curBinId);
+                LOG_DEBUG(LOG_AGENT, "A%d arrives at target (%d,%d). CurBinId: %d\n", id, targetLoc.x, targetLoc.y, 
+                    curBinId);
                 if (targetBinId == -1 && curBinId != -1) {
-                    int eIdx = getBinIndexById(bins, curBinId);
-                    bins[eIdx].loc = curLoc;
-                    bins[eIdx].onGround = true;
-                    printf("A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[eIdx].id, 
+                    int eIdx = bins.indexOf(curBinId);
+                    world.dropBin(eIdx, curLoc);
+                    LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[eIdx].id, 
                         bins[eIdx].loc.x, bins[eIdx].loc.y);
                     curBinId = -1;
-                    filterRegisteredLocations(requests, bins[eIdx].loc);
+                    world.removeRequests(bins[eIdx].loc);
                 } else {
-                    int tIdx = getBinIndexById(bins, targetBinId);
+                    int tIdx = bins.indexOf(targetBinId);
                     if (round(bins[tIdx].capacity) >= BIN_CAPACITY) { // Target bin is full
                         if (curBinId != -1) { // Agent is carrying an empty bin
-                            int eIdx = getBinIndexById(bins, curBinId);
-                            bins[eIdx].loc = curLoc;
-                            bins[eIdx].onGround = true;
-                            printf("A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[eIdx].id, 
-                                bins[eIdx].loc.x, bins[eIdx].loc.y);
-                            filterRegisteredLocations(requests, bins[eIdx].loc);
+                            int eIdx = bins.indexOf(curBinId);
+                            world.dropBin(eIdx, curLoc);
+                            LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, 
+                                bins[eIdx].id, bins[eIdx].loc.x, bins[eIdx].loc.y);
+                            world.removeRequests(bins[eIdx].loc);
                         }
                         curBinId = targetBinId; // pick up target bin
-                        int cIdx = getBinIndexById(bins, curBinId);
-                        printf("A%d(%d,%d) picks up B%d(%d,%d).\n", id, curLoc.x, curLoc.y, curBinId, 
+                        int cIdx = bins.indexOf(curBinId);
+                        LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) picks up B%d(%d,%d).\n", id, curLoc.x, curLoc.y, curBinId, 
                             bins[cIdx].loc.x, bins[cIdx].loc.y);
                         targetLoc = getRepoLocation();
                         move(bins[cIdx]);
                         if (cIdx != -1) {
-                            bins[cIdx].capacity = round(bins[cIdx].capacity);
-                            bins[cIdx].loc = curLoc;
-                            bins[cIdx].onGround = false;
+                            world.setBinCapacity(cIdx, round(bins[cIdx].capacity));
+                            world.moveBin(cIdx, curLoc);
+                            world.pickUpBin(cIdx);
                         }
-                        printf("A%d moves to (%d,%d). TargetBin: B%d.\n", id, curLoc.x, curLoc.y, targetBinId);
+                        LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). TargetBin: B%d.\n", id, curLoc.x, curLoc.y, 
+                            targetBinId);
                     } else { // agent arrived at target location, but target bin is not full yet; agent waits
-                        int tIdx = getBinIndexById(bins, targetBinId);
-                        printf("A%d(%d,%d) is waiting for B%d(%d,%d) to be filled.\n", id, curLoc.x, curLoc.y, 
-                            bins[tIdx].id, bins[tIdx].loc.x, bins[tIdx].loc.y);
+                        int tIdx = bins.indexOf(targetBinId);
+                        LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) is waiting for B%d(%d,%d) to be filled.\n", id, curLoc.x, 
+                            curLoc.y, bins[tIdx].id, bins[tIdx].loc.x, bins[tIdx].loc.y);
                     }
                 }
             } else {
-                int cIdx = getBinIndexById(bins, curBinId);
+                int cIdx = bins.indexOf(curBinId);
                 move(bins[cIdx]);
                 if (cIdx != -1)
-                    bins[cIdx].loc = curLoc;
-                printf("A%d moves to (%d,%d). CurBin: B%d. Target: B%d.\n", id, curLoc.x, curLoc.y, 
+                    world.moveBin(cIdx, curLoc);
+                LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). CurBin: B%d. Target: B%d.\n", id, curLoc.x, curLoc.y, 
                     curBinId, targetBinId);
             }
         }
@@ -395,19 +395,18 @@ void Agent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector
     
     if (curLoc.x == 0) {
         // Arrived at REPO
-        int carriedCapacity = round(bins[getBinIndexById(bins, curBinId)].capacity);
+        int carriedCapacity = round(bins[bins.indexOf(curBinId)].capacity);
         if (curBinId != -1 && carriedCapacity >= BIN_CAPACITY) { // Carrying a full bin
-            int idx = getBinIndexById(bins, curBinId);
+            int idx = bins.indexOf(curBinId);
             if (idx >= 0 && idx < (int) bins.size()) {
-                repo.push_back(copyBin(bins[idx])); // Put carried bin in repo
-                printf("A%d(%d,%d) put B%d in REPO.\n", id, curLoc.x, curLoc.y, curBinId);
-                bins.erase(bins.begin() + idx);
+                LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) put B%d in REPO.\n", id, curLoc.x, curLoc.y, curBinId);
+                world.deliverBin(idx, copyBin(bins[idx])); // Put carried bin in repo
                 // Reset all
                 curBinId = -1;
                 targetBinId = -1;
                 targetLoc = Coordinate(-1, -1);
             } else {
-                printf("A%d current bin ID B%d, index %d?\n", id, curBinId, idx);
+                LOG_DEBUG(LOG_AGENT, "A%d current bin ID B%d, index %d?\n", id, curBinId, idx);
             }
         }
     }
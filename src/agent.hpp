@@ -4,60 +4,72 @@
 #include <vector>
 #include "data_structs.hpp"
 #include "orchard.hpp"
+#include "bin_store.hpp"
+#include "world_view.hpp"
+
+class Agent;
+
+typedef WorldView<Agent> AgentWorld;
 
 class Agent
 {
 public:
-    Agent(int i, Coordinate c);
+    Agent(int i, Coordinate c, const Orchard &env);
     
     ~Agent();
     
-    Coordinate getCurLoc() { return curLoc; }
+    Coordinate getCurLoc() const { return curLoc; }
     
-    Coordinate getTargetLoc() { return targetLoc; }
+    Coordinate getTargetLoc() const { return targetLoc; }
     
-    int getCurBinId() { return curBinId; }
+    int getCurBinId() const { return curBinId; }
     
-    int getTargetBinId() { return targetBinId; }
+    int getTargetBinId() const { return targetBinId; }
     
-    int getStepCount(Coordinate src, Coordinate dst);
+    void getIdleBins(const AgentWorld &world, std::vector<int> &idleBins) const;
     
-    int getBinIndexById(std::vector<AppleBin> bins, int id);
+    // Whether no agent has anything to decide in the next tick: each one travels towards its target or the repo, 
+    // waits at a target bin that is not full yet, or is idle with no bin to pick up and no location request. 
+    // trips gets what each agent does until it has something to decide again.
+    static bool isQuiet(const AgentWorld &world, std::vector<Trip> &trips);
     
-    std::vector<int> getIdleBins(std::vector<AppleBin> bins, std::vector<Agent> agents);
+    // Where ticks more ticks of the trip isQuiet gave take the agent and its bin
+    void followTrip(AgentWorld &world, const Trip &trip, int ticks);
     
-    void takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector<AppleBin> &repo, 
-        std::vector<Agent> &agents, Orchard env, std::vector<LocationRequest> &requests);
+    void takeAction(AgentWorld &world);
     
-    void move(AppleBin curBin);
+    void move(const AppleBin &curBin);
     
 private:
     int id;
+    const DistanceOracle *oracle; // Owned by the orchard
     Coordinate curLoc;
     Coordinate targetLoc;
     int curBinId;
     int targetBinId;
     
-    int getClosestFullBin(std::vector<int> indexes, std::vector<AppleBin> bins);
+    // Scratch space reused every tick
+    std::vector<int> idleBinScratch;
+    std::vector<Coordinate> binLocs;
+    std::vector<int> binSteps;
     
-    int getFirstEstFullBin(std::vector<int> indexes, std::vector<AppleBin> bins);
+    int getClosestFullBin(const std::vector<int> &indexes, const BinStore &bins);
     
-    void filterRegisteredLocations(std::vector<LocationRequest> &requests, Coordinate loc);
+    int getFirstEstFullBin(const std::vector<int> &indexes, const BinStore &bins);
     
-    int getBinIndexByLocation(std::vector<Agent> &agents, std::vector<AppleBin> &bins, Coordinate loc);
+    int getBinIndexByLocation(const AgentWorld &world, Coordinate loc);
     
-    int getBinIndexByLocation(std::vector<AppleBin> bins, Coordinate loc);
+    int getBinIndexByLocation(const BinStore &bins, Coordinate loc);
 
-    int checkIfCarryingBin(std::vector<Agent> &agents, std::vector<AppleBin> &bins, Coordinate loc);
+    int checkIfCarryingBin(ConstSpan<Agent> agents, Coordinate loc);
     
-    Coordinate selectNewLocation(std::vector<Agent> &agents, std::vector<AppleBin> &bins, 
-        std::vector<LocationRequest> &requests);
+    Coordinate selectNewLocation(const AgentWorld &world);
     
     Coordinate getRepoLocation() { return Coordinate(0, curLoc.y); /* Repo at column 0 at every row */ }
     
-    bool isLocationValid(Coordinate loc);
+    bool isLocationValid(Coordinate loc) { return oracle->isValid(loc); }
     
-    bool agentWithNewBin(std::vector<Agent> agents, std::vector<AppleBin> bins, Coordinate loc);
+    bool agentWithNewBin(const AgentWorld &world, Coordinate loc);
     
     AppleBin copyBin(AppleBin ab);
 };
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include "auction.hpp"
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void AuctionEngine::clear(int n)
+{
+    numAgents = n;
+    bids.resize(n);
+    for (int a = 0; a < n; ++a)
+        bids[a].clear();
+    assignedBin.assign(n, -1);
+    assignedValue.assign(n, 0);
+    openBids.assign(n, 0);
+}
+
+void AuctionEngine::addBid(int agent, int binId, float value)
+{
+    bids[agent].push_back(Bid(binId, value));
+}
+
+int AuctionEngine::getNumBids() const
+{
+    int count = 0;
+    for (int a = 0; a < numAgents; ++a)
+        count += (int) bids[a].size();
+    return count;
+}
+
+int AuctionEngine::getNumAssigned() const
+{
+    int count = 0;
+    for (int a = 0; a < numAgents; ++a)
+        count += (assignedBin[a] != -1);
+    return count;
+}
+
+void AuctionEngine::assign()
+{
+    double start = now();
+    assignedBin.assign(numAgents, -1);
+    assignedValue.assign(numAgents, 0);
+    if (mode == OPTIMAL)
+        assignOptimal();
+    else
+        assignGreedy();
+    assignTime = now() - start;
+}
+
+// A bid is open unless another agent already took its bin
+bool AuctionEngine::isOpen(int agent, int k) const
+{
+    std::map<int, int>::const_iterator it = takenBy.find(bids[agent][k].binId);
+    return it == takenBy.end() || it->second == agent;
+}
+
+// Moves the agent's best open bid to the next open one; NaN values never beat anybody, so they are not indexed
+void AuctionEngine::advanceHead(int agent)
+{
+    int k = head[agent];
+    if (k != -1 && bids[agent][k].value == bids[agent][k].value)
+        heads[bids[agent][k].binId].erase(std::make_pair(bids[agent][k].value, agent));
+    
+    for (++k; k < (int) bids[agent].size() && !isOpen(agent, k); ++k)
+        ;
+    if (k == (int) bids[agent].size()) {
+        head[agent] = -1;
+        return;
+    }
+    head[agent] = k;
+    if (bids[agent][k].value == bids[agent][k].value)
+        heads[bids[agent][k].binId].insert(std::make_pair(bids[agent][k].value, agent));
+}
+
+void AuctionEngine::assignGreedy()
+{
+    takenBy.clear();
+    heads.clear();
+    head.assign(numAgents, -1);
+    for (int a = 0; a < numAgents; ++a)
+        advanceHead(a);
+    
+    std::vector<int> losers;
+    for (int a = 0; a < numAgents; ++a) {
+        openBids[a] = 0;
+        for (int k = 0; k < (int) bids[a].size(); ++k)
+            openBids[a] += isOpen(a, k);
+        
+        for (int k = 0; k < (int) bids[a].size(); ++k) {
+            if (!isOpen(a, k))
+                continue;
+            const Bid &bid = bids[a][k];
+            
+            // Cheapest best open bid of any other agent on the same bin
+            bool win = true;
+            std::map<int, std::set<std::pair<float, int> > >::iterator it = heads.find(bid.binId);
+            if (it != heads.end()) {
+                std::set<std::pair<float, int> >::iterator h;
+                for (h = it->second.begin(); h != it->second.end() && h->second == a; ++h)
+                    ;
+                if (h != it->second.end())
+                    win = bid.value <= h->first;
+            }
+            if (!win)
+                continue;
+            
+            assignedBin[a] = bid.binId;
+            assignedValue[a] = bid.value;
+            takenBy[bid.binId] = a;
+            // The bin is closed for everybody else; agents whose best open bid was on it move on
+            losers.clear();
+            for (int c = 0; c < numAgents; ++c) {
+                if (c != a && head[c] != -1 && bids[c][head[c]].binId == bid.binId)
+                    losers.push_back(c);
+            }
+            for (int i = 0; i < (int) losers.size(); ++i)
+                advanceHead(losers[i]);
+            break;
+        }
+    }
+}
+
+void AuctionEngine::assignOptimal()
+{
+    const double UNASSIGNED = 1e7; // Cost of leaving an agent without a bin; above any path value
+    const double NO_BID = 1e10;
+    const double INF = HUGE_VAL;
+    
+    // Rows are the agents with a usable bid, columns their bins and then one "unassigned" column per row
+    std::vector<int> rowAgent;
+    std::map<int, int> binCol;
+    std::vector<int> colBin;
+    for (int a = 0; a < numAgents; ++a) {
+        openBids[a] = (int) bids[a].size();
+        bool usable = false;
+        for (int k = 0; k < (int) bids[a].size(); ++k) {
+            if (bids[a][k].value != bids[a][k].value)
+                continue;
+            usable = true;
+            if (binCol.insert(std::make_pair(bids[a][k].binId, (int) colBin.size())).second)
+                colBin.push_back(bids[a][k].binId);
+        }
+        if (usable)
+            rowAgent.push_back(a);
+    }
+    int n = (int) rowAgent.size();
+    int numBins = (int) colBin.size();
+    int m = numBins + n;
+    
+    // 1-indexed cost matrix; bids come cheapest first, so the first bid on a bin is the agent's cost for it
+    std::vector<double> cost((size_t) (n + 1) * (m + 1), NO_BID);
+    for (int i = 1; i <= n; ++i) {
+        double *row = &cost[(size_t) i * (m + 1)];
+        const std::vector<Bid> &b = bids[rowAgent[i - 1]];
+        for (int k = 0; k < (int) b.size(); ++k) {
+            int j = binCol[b[k].binId] + 1;
+            if (b[k].value == b[k].value && row[j] == NO_BID)
+                row[j] = b[k].value;
+        }
+        for (int j = numBins + 1; j <= m; ++j)
+            row[j] = UNASSIGNED;
+    }
+    
+    // Warm start from last round's pairs and bin potentials. A column may keep a potential below 0 only while 
+    // it is matched, so start from every old pair that still has a bid, take the row potentials those column 
+    // potentials allow, and drop the pairs that are not tight until all remaining ones are.
+    std::vector<double> u(n + 1, 0);
+    std::vector<double> v(m + 1, 0);
+    std::vector<int> p(m + 1, 0);
+    std::vector<int> way(m + 1, 0);
+    std::vector<int> rowCol(n + 1, 0);
+    for (int i = 1; i <= n; ++i) {
+        int a = rowAgent[i - 1];
+        if (a >= (int) lastBin.size() || lastBin[a] == -1 || binCol.find(lastBin[a]) == binCol.end())
+            continue;
+        int j = binCol[lastBin[a]] + 1;
+        if (cost[(size_t) i * (m + 1) + j] == NO_BID)
+            continue;
+        rowCol[i] = j;
+        p[j] = i;
+        v[j] = std::min(0.0, binPotential[lastBin[a]]);
+    }
+    bool dropped = true;
+    while (dropped) {
+        dropped = false;
+        for (int i = 1; i <= n; ++i) {
+            const double *row = &cost[(size_t) i * (m + 1)];
+            u[i] = INF;
+            for (int j = 1; j <= m; ++j)
+                u[i] = std::min(u[i], row[j] - v[j]);
+        }
+        for (int i = 1; i <= n; ++i) {
+            int j = rowCol[i];
+            double c = cost[(size_t) i * (m + 1) + j];
+            if (j != 0 && c - u[i] - v[j] > 1e-9 * std::max(1.0, fabs(c))) {
+                rowCol[i] = 0;
+                p[j] = 0;
+                v[j] = 0;
+                dropped = true;
+            }
+        }
+    }
+    
+    // Hungarian algorithm: one shortest augmenting path per unmatched row
+    std::vector<double> minv(m + 1);
+    std::vector<bool> used(m + 1);
+    for (int i = 1; i <= n; ++i) {
+        if (rowCol[i] != 0)
+            continue;
+        p[0] = i;
+        int j0 = 0;
+        minv.assign(m + 1, INF);
+        used.assign(m + 1, false);
+        do {
+            used[j0] = true;
+            int i0 = p[j0];
+            const double *row = &cost[(size_t) i0 * (m + 1)];
+            double delta = INF;
+            int j1 = 0;
+            for (int j = 1; j <= m; ++j) {
+                if (used[j])
+                    continue;
+                double cur = row[j] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= m; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    
+    lastBin.assign(numAgents, -1);
+    for (int j = 1; j <= numBins; ++j) {
+        if (p[j] == 0 || cost[(size_t) p[j] * (m + 1) + j] == NO_BID)
+            continue;
+        int a = rowAgent[p[j] - 1];
+        assignedBin[a] = colBin[j - 1];
+        assignedValue[a] = (float) cost[(size_t) p[j] * (m + 1) + j];
+        lastBin[a] = colBin[j - 1];
+    }
+    
+    binPotential.clear();
+    for (int j = 1; j <= numBins; ++j)
+        binPotential[colBin[j - 1]] = v[j];
+}
@@ -0,0 +1,90 @@
+#ifndef AUCTION_HPP_
+#define AUCTION_HPP_
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+/*
+ * Assigns bins to agents from the plans they made this tick. Every plan is a bid: the agent's value (time) for 
+ * a path starting with that bin, lower is better. Two modes:
+ * 
+ * GREEDY replays the sequential auction the agents always ran: in agent order, an agent takes the first bin of 
+ * its cheapest open bid unless another agent's best open bid is on the same bin and strictly cheaper, and a 
+ * taken bin is closed for everybody else. Every agent's best open bid is indexed by bin, so each bid is checked 
+ * in O(log n) instead of against every agent.
+ * 
+ * OPTIMAL solves the assignment problem on the cost matrix of agents x bins (an agent's cost for a bin is its 
+ * cheapest bid on it, and any agent may stay unassigned at a large cost) with the Hungarian algorithm. The bin 
+ * potentials and the assignment of the last round are kept: the next round starts from them, keeps every old 
+ * pair that is still tight, and only searches augmenting paths for the agents left over, so a matrix that 
+ * changed little costs little.
+ */
+class AuctionEngine
+{
+public:
+    enum Mode { GREEDY, OPTIMAL };
+    
+    AuctionEngine(Mode m = GREEDY) : mode(m), numAgents(0), assignTime(0) {}
+    
+    Mode getMode() const { return mode; }
+    
+    // New round for agents 0 .. n-1, without bids
+    void clear(int n);
+    
+    // Bids of an agent are added in ascending value, the order makePlans keeps its plans in
+    void addBid(int agent, int binId, float value);
+    
+    void assign();
+    
+    // Bin assigned to the agent in the last assign(), or -1
+    int getBin(int agent) const { return assignedBin[agent]; }
+    
+    float getValue(int agent) const { return assignedValue[agent]; }
+    
+    // Bids of the agent still open when its turn came (GREEDY), or all of its bids (OPTIMAL)
+    int getNumOpenBids(int agent) const { return openBids[agent]; }
+    
+    int getNumBids() const;
+    
+    int getNumAssigned() const;
+    
+    // Wall time of the last assign(), in seconds
+    double getAssignTime() const { return assignTime; }
+
+private:
+    struct Bid
+    {
+        int binId;
+        float value;
+        Bid(int b, float v) : binId(b), value(v) {}
+    };
+    
+    Mode mode;
+    int numAgents;
+    std::vector<std::vector<Bid> > bids;
+    std::vector<int> assignedBin;
+    std::vector<float> assignedValue;
+    std::vector<int> openBids;
+    double assignTime;
+    
+    // GREEDY: next open bid of every agent, and those bids indexed by bin as (value, agent)
+    std::vector<int> head;
+    std::map<int, int> takenBy;
+    std::map<int, std::set<std::pair<float, int> > > heads;
+    
+    // OPTIMAL: state carried over to the next round
+    std::map<int, double> binPotential;
+    std::vector<int> lastBin;
+    
+    bool isOpen(int agent, int k) const;
+    
+    void advanceHead(int agent);
+    
+    void assignGreedy();
+    
+    void assignOptimal();
+};
+
+#endif // AUCTION_HPP_
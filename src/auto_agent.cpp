@@ -5,15 +5,21 @@
 #include <cfloat>
 #include <climits>
 #include "auto_agent.hpp"
+#include "log.hpp"
 
 const float AutoAgent::C_H = 0.6;
 const float AutoAgent::C_B = 0.4;
 
-std::vector<AutoState> AutoAgent::states;
+StateTable AutoAgent::states;
 
-AutoAgent::AutoAgent(int i, Coordinate c, int n, bool learn)
+// Estimated fill time in a state whose agent has no target bin, or whose bin is not being filled
+static const int NO_FILL_TIME = -1;
+
+AutoAgent::AutoAgent(int i, Coordinate c, int n, const Orchard &env, bool learn)
 {
     id = i;
+    oracle = &env.getDistance();
+    requestQueue = NULL;
     curLoc = c;
     numLayers = n;
     useLearning = learn;
@@ -24,6 +30,15 @@ AutoAgent::AutoAgent(int i, Coordinate c, int n, bool learn)
     activePlan = Plan(-1, 0);
     activeLocation = Coordinate(-1, -1);
     activeStateIndex = -1;
+    numIdleSeen = -1;
+    planVersion = -1;
+    planLoc = Coordinate(-1, -1);
+    planBudget = 0;
+    depth = n;
+    planTime = -1;
+    planCut = false;
+    scoreEpoch = 0;
+    scoreLoc = Coordinate(-1, -1);
     plans.clear();
 }
 
@@ -38,21 +53,36 @@ AutoAgent::~AutoAgent()
     plans.clear();
 }
 
-int AutoAgent::getBinIndexById(std::vector<AppleBin> bins, int id)
+void AutoAgent::trackRequests(RequestQueue *q)
 {
-    for (int b = 0; b < (int) bins.size(); ++b) {
-        if (bins[b].id == id)
-            return b;
-    }
-    return -1;
+    requestQueue = q;
+    if (requestQueue != NULL)
+        requestQueue->setAgent(id, activeLocation, targetLoc);
 }
 
-std::vector<int> AutoAgent::getIdleBins(std::vector<AutoAgent> agents, std::vector<AppleBin> bins)
+void AutoAgent::setActiveLocation(Coordinate loc)
 {
-    std::vector<int> idleBins;
+    activeLocation = loc;
+    if (requestQueue != NULL)
+        requestQueue->setAgent(id, activeLocation, targetLoc);
+}
+
+void AutoAgent::setTargetLoc(Coordinate loc)
+{
+    targetLoc = loc;
+    if (requestQueue != NULL)
+        requestQueue->setAgent(id, activeLocation, targetLoc);
+}
+
+void AutoAgent::getIdleBins(const AutoWorld &world, std::vector<int> &idleBins)
+{
+    const BinStore &bins = world.getBins();
+    ConstSpan<AutoAgent> agents = world.getAgents();
+    const DistanceOracle &dist = world.getOrchard().getDistance();
+    idleBins.clear();
     
     if (bins.size() == 0)
-        return idleBins;
+        return;
     
     for (int b = 0; b < (int) bins.size(); ++b) {
         if (bins[b].onGround)
@@ -62,54 +92,151 @@ std::vector<int> AutoAgent::getIdleBins(std::vector<AutoAgent> agents, std::vect
     }
     
     for (int a = 0; a < (int) agents.size(); ++a) {
-        if (agents[a].id == id)
-            continue;
-        int bIdx = getBinIndexById(bins, agents[a].curBinId);
+        int bIdx = bins.indexOf(agents[a].curBinId);
         if (bIdx != -1)
             idleBins[bIdx] = -1;
-        int stepCount = getStepCount(agents[a].curLoc, agents[a].activeLocation);
+        int stepCount = dist.getStepCount(agents[a].curLoc, agents[a].activeLocation);
         if (bIdx != -1 && stepCount <= AGENT_SPEED_H && agents[a].activeLocation.x != 0 && agents[a].activeLocation.x != -1) {
             idleBins[bIdx] = bIdx;
         }
     }
     
     for (int a = 0; a < (int) agents.size(); ++a) {
-        int tIdx = getBinIndexById(bins, agents[a].targetBinId);
+        int tIdx = bins.indexOf(agents[a].targetBinId);
         if (tIdx != -1)
             idleBins[tIdx] = -1;
     }
     
-    for (int i = 0; i < (int) idleBins.size(); ++i) {
-        if (idleBins[i] == -1) {
-            idleBins.erase(idleBins.begin() + i);
-            --i;
-        }
-    }
+    idleBins.erase(std::remove(idleBins.begin(), idleBins.end(), -1), idleBins.end());
     
     /*printf("IdleBins: ");
     for (int i = 0; i < (int) idleBins.size(); ++i)
         printf("B%d ", bins[idleBins[i]].id);
     printf("\n");*/
-    
-    return idleBins;
 }
 
-int AutoAgent::getStepCount(Coordinate src, Coordinate dst)
+bool AutoAgent::isQuiet(const AutoWorld &world, bool *parked, std::vector<Trip> &trips)
 {
-    int initStep = 0;
-    if (!isLocationValid(src) || !isLocationValid(dst))
-        return 0;
-    
-    if (src.y != dst.y) {
-        int leftStep = src.x - 0;
-        int rightStep = ORCH_COLS - 1 - src.x;
-        initStep = (leftStep <= rightStep) ? leftStep : rightStep;
+    const BinStore &bins = world.getBins();
+    ConstSpan<AutoAgent> agents = world.getAgents();
+    *parked = false;
+    trips.assign(agents.size(), Trip());
+    for (int a = 0; a < (int) agents.size(); ++a) {
+        const AutoAgent &ag = agents[a];
+        const DistanceOracle &dist = *ag.oracle;
+        Trip &trip = trips[a];
+        trip.dst = ag.curLoc;
+        if (ag.curBinId == -1 && ag.targetBinId == -1 && !dist.isValid(ag.activeLocation)) {
+            // Parked once the repo move left an invalid target behind
+            if (ag.targetLoc.x != 0 || dist.isValid(ag.targetLoc))
+                return false;
+            *parked = true;
+            continue;
+        }
+        if (ag.curLoc.x == 0) // At the repo an agent takes new bins and location requests
+            return false;
+        int cIdx = bins.indexOf(ag.curBinId);
+        trip.bin = cIdx;
+        trip.atRepo = true; // Passing the repo column, it may deliver or take a bin
+        int speed = (cIdx != -1 && bins[cIdx].capacity > 0) ? AGENT_SPEED_L : AGENT_SPEED_H; // As move picks it
+        bool validTarget = dist.isValid(ag.targetLoc);
+        bool atTarget = ag.curLoc.x == ag.targetLoc.x && ag.curLoc.y == ag.targetLoc.y;
+        if (dist.isValid(ag.activeLocation) 
+            && !(ag.activeLocation.x == ag.targetLoc.x && ag.activeLocation.y == ag.targetLoc.y)) {
+            // Carries a new bin to its location request. Idle agents may take the bin once it is close, and the 
+            // agent stops to act if it comes across its target bin.
+            if (cIdx == -1 || dist.getStepCount(ag.curLoc, ag.activeLocation) <= AGENT_SPEED_H)
+                return false;
+            if (!validTarget && ag.targetLoc.x != 0) // Would send its target to the repo
+                return false;
+            trip.dst = ag.activeLocation;
+            trip.speed = speed;
+            trip.margin = AGENT_SPEED_H;
+            if (validTarget)
+                trip.watch = ag.targetLoc;
+            continue;
+        }
+        if (!validTarget)
+            return false;
+        int tIdx = bins.indexOf(ag.targetBinId);
+        if (atTarget) { // Waits unless the target bin is full
+            if (tIdx == -1 || !bins[tIdx].onGround || round(bins[tIdx].capacity) >= BIN_CAPACITY)
+                return false;
+            continue;
+        }
+        if (ag.targetBinId != -1) { // Travels to its target bin
+            if (tIdx == -1 || !bins[tIdx].onGround)
+                return false;
+        } else if (ag.targetLoc.x != 0 || cIdx == -1) { // Anything but bringing a bin to the repo
+            return false;
+        }
+        trip.dst = ag.targetLoc;
+        trip.speed = speed;
     }
-    
-    return initStep + abs(src.x - dst.x) + abs(src.y - dst.y);
+    if (*parked) { // A parked agent would take a location request or bid for an idle bin
+        if (world.getRequests().size() > 0)
+            return false;
+        std::vector<int> idleBins;
+        getIdleBins(world, idleBins);
+        if (!idleBins.empty())
+            return false;
+    }
+    return true;
 }
 
-int AutoAgent::getBinIndexByLoc(std::vector<AppleBin> bins, Coordinate loc)
+void AutoAgent::followTrip(AutoWorld &world, const Trip &trip, int ticks)
+{
+    curLoc = oracle->advance(curLoc, trip.dst, trip.speed * ticks);
+    if (trip.bin != -1)
+        world.moveBin(trip.bin, curLoc);
+}
+
+void AutoAgent::collectIdleBins(const AutoWorld &world, IdleBinSet &idle)
+{
+    const BinStore &bins = world.getBins();
+    int prevSize = (int) idle.binId.size();
+    getIdleBins(world, idle.index);
+    int n = idle.size();
+    bool changed = (n != prevSize);
+    ++idle.updates;
+    
+    idle.binId.resize(n);
+    idle.stamp.resize(n);
+    idle.batch.clear();
+    for (int i = 0; i < n; ++i) {
+        AppleBin ab = bins[idle.index[i]];
+        if (!ab.onGround) {
+            ab.loc = getCarrierDestination(ab, world.getAgents());
+            ab.fillRate = world.countWorkersAt(ab.loc) * PICK_RATE;
+        }
+        float apples = world.getOrchard().getApplesAt(ab.loc);
+        idle.batch.push(ab.loc, ab.capacity, ab.fillRate, apples);
+        
+        if (ab.id >= (int) idle.last.size())
+            idle.last.resize(ab.id + 1);
+        IdleBinSet::Inputs &in = idle.last[ab.id];
+        if (in.seen != idle.updates - 1 || in.x != ab.loc.x || in.y != ab.loc.y || in.capacity != ab.capacity 
+            || in.fillRate != ab.fillRate || in.apples != apples) {
+            in.x = ab.loc.x;
+            in.y = ab.loc.y;
+            in.capacity = ab.capacity;
+            in.fillRate = ab.fillRate;
+            in.apples = apples;
+            in.stamp = idle.updates;
+            changed = true;
+        }
+        in.seen = idle.updates;
+        
+        if (i >= prevSize || idle.binId[i] != ab.id)
+            changed = true;
+        idle.binId[i] = ab.id;
+        idle.stamp[i] = in.stamp;
+    }
+    if (changed)
+        ++idle.version;
+}
+
+int AutoAgent::getBinIndexByLoc(const BinStore &bins, Coordinate loc)
 {
     for (int i = 0; i < (int) bins.size(); ++i) {
         if (bins[i].loc.x == loc.x && bins[i].loc.y == loc.y)
@@ -118,7 +245,7 @@ int AutoAgent::getBinIndexByLoc(std::vector<AppleBin> bins, Coordinate loc)
     return -1;
 }
 
-float AutoAgent::calcWaitTime(AppleBin ab, Orchard env, float reachTime, std::vector<AppleBin> bins)
+float AutoAgent::calcWaitTime(const AppleBin &ab, const Orchard &env, float reachTime)
 {
     float harvestedApples = ab.fillRate * (reachTime);
     if (env.getApplesAt(ab.loc) - harvestedApples <= 0)
@@ -129,7 +256,7 @@ float AutoAgent::calcWaitTime(AppleBin ab, Orchard env, float reachTime, std::ve
     return remCapacity / ab.fillRate;
 }
 
-Coordinate AutoAgent::getCarrierDestination(AppleBin ab, std::vector<AutoAgent> agents)
+Coordinate AutoAgent::getCarrierDestination(const AppleBin &ab, ConstSpan<AutoAgent> agents)
 {
     for (int i = 0; i < (int) agents.size(); ++i) {
         if (agents[i].curBinId == ab.id)
@@ -138,21 +265,11 @@ Coordinate AutoAgent::getCarrierDestination(AppleBin ab, std::vector<AutoAgent>
     return Coordinate(-1, -1);
 }
 
-int AutoAgent::countWorkersAt(Coordinate loc, std::vector<Worker> workers)
-{
-    int count = 0;
-    for (int i = 0; i < (int) workers.size(); ++i) {
-        if (workers[i].loc.x == loc.x && workers[i].loc.y == loc.y)
-            count++;
-    }
-    return count;
-}
-
-float AutoAgent::calcPathValues(int binPath[], std::vector<AppleBin> bins, std::vector<AutoAgent> agents, Orchard env, 
-    std::vector<Worker> workers)
+float AutoAgent::calcPathValues(int binPath[], const AutoWorld &world, const Orchard &env)
 {
+    const BinStore &bins = world.getBins();
     float sum = 0;
-    float times[numLayers];
+    std::vector<float> times(numLayers);
     
     for (int j = 0; j < numLayers; ++j) {
         if (binPath[j] == -1)
@@ -160,14 +277,14 @@ float AutoAgent::calcPathValues(int binPath[], std::vector<AppleBin> bins, std::
         
         AppleBin ab = bins[binPath[j]];
         if (!ab.onGround) {
-            ab.loc = getCarrierDestination(ab, agents);
-            ab.fillRate = countWorkersAt(ab.loc, workers) * PICK_RATE;
+            ab.loc = getCarrierDestination(ab, world.getAgents());
+            ab.fillRate = world.countWorkersAt(ab.loc) * PICK_RATE;
         }
         //printf("[A%d] B%d, (%d,%d) fillRate: %4.2f\n", id, ab.id, ab.loc.x, ab.loc.y, ab.fillRate);
         
         float prevTime = (j > 0) ? times[j - 1] : 0;
-        float reachTime = ((float) getStepCount(curLoc, ab.loc)) / AGENT_SPEED_H;
-        float waitTime = calcWaitTime(ab, env, reachTime, bins);
+        float reachTime = ((float) oracle->getStepCount(curLoc, ab.loc)) / AGENT_SPEED_H;
+        float waitTime = calcWaitTime(ab, env, reachTime);
         float returnTime = (ab.loc.x - 0) / AGENT_SPEED_L; // bin.loc.x - 0 (repo at column 0)
         //printf("[A%d] B%d, reach: %4.2f, wait: %4.2f, return: %4.2f\n", id, ab.id, reachTime, waitTime, returnTime);
         times[j] = prevTime + reachTime + waitTime + returnTime;
@@ -182,195 +299,222 @@ float AutoAgent::calcPathValues(int binPath[], std::vector<AppleBin> bins, std::
     return sum;
 }
 
-bool planComparator(Plan p1, Plan p2)
+void AutoAgent::makePlans(const AutoWorld &world, const IdleBinSet &idle)
 {
-    return p1.value < p2.value;
-}
-
-void AutoAgent::makePlans(std::vector<AutoAgent> agents, std::vector<AppleBin> bins, Orchard env, 
-    std::vector<Worker> workers)
-{
-    plans.clear();
-    if (curBinId != -1 || targetBinId != -1) // agent is not idle; don't make a new plan
+    numIdleSeen = -1;
+    planTime = -1;
+    if (curBinId != -1 || targetBinId != -1) { // agent is not idle; don't make a new plan
+        plans.clear();
+        planVersion = -1;
+        planCut = false;
         return;
+    }
     
-    std::vector<int> idleBins = getIdleBins(agents, bins);
-    printf("A%d sees %d idle bins.\n", id, (int) idleBins.size());
-    if (idleBins.size() == 0)
+    numIdleSeen = idle.size();
+    // Plans depend only on the idle bins' inputs and the agent's cell; keep them while neither changed, unless the 
+    // budget cut them short and a shallower search may do better
+    if (planVersion == idle.version && curLoc.x == planLoc.x && curLoc.y == planLoc.y && !planCut)
+        return;
+    double start = planClock();
+    planCut = false;
+    plans.clear();
+    planVersion = idle.version;
+    planLoc = curLoc;
+    if (idle.size() == 0) {
+        planTime = 0;
         return;
+    }
     
-    int numIdleBins = idleBins.size();
-    int binSeqs[numIdleBins][numLayers];
+    int numIdleBins = idle.size();
     
-    for (int i = 0; i < numIdleBins; ++i)
-        for (int j = 0; j < numLayers; ++j)
-            binSeqs[i][j] = -1; // Initialization
+    // Reach times change with the agent's cell, so moving invalidates every cached score
+    if (curLoc.x != scoreLoc.x || curLoc.y != scoreLoc.y) {
+        ++scoreEpoch;
+        scoreLoc = curLoc;
+    }
     
-    // Create possible bin sequences
+    // The time spent on a bin does not depend on its place in the sequence, so score a bin only when its inputs
+    // changed since this agent last scored it
+    dirty.clear();
+    dirtySlots.clear();
     for (int i = 0; i < numIdleBins; ++i) {
-        for (int j = 0; j < numLayers && j < numIdleBins; ++j)
-            binSeqs[i][j] = idleBins[j];
-        std::next_permutation(idleBins.begin(), idleBins.end());
+        int b = idle.binId[i];
+        if (b >= (int) scores.size())
+            scores.resize(b + 1);
+        if (scores[b].epoch != scoreEpoch || scores[b].stamp != idle.stamp[i]) {
+            dirty.push(Coordinate(idle.batch.x[i], idle.batch.y[i]), idle.batch.capacity[i], 
+                idle.batch.fillRate[i], idle.batch.apples[i]);
+            dirtySlots.push_back(i);
+        }
+    }
+    scoreBinBatch(*oracle, curLoc, dirty);
+    for (int d = 0; d < dirty.size(); ++d) {
+        BinScore &s = scores[idle.binId[dirtySlots[d]]];
+        s.epoch = scoreEpoch;
+        s.stamp = idle.stamp[dirtySlots[d]];
+        s.steps = dirty.steps[d];
+        s.reachTime = dirty.reachTime[d];
+        s.waitTime = dirty.waitTime[d];
+        s.returnTime = dirty.returnTime[d];
     }
     
-    for (int i = 0; i < numIdleBins; ++i)
-        plans.push_back(Plan(bins[binSeqs[i][0]].id, calcPathValues(binSeqs[i], bins, agents, env, workers)));
-    
-    std::sort(plans.begin(), plans.end(), planComparator); // sort by plan value, ascending
+    batch = idle.batch;
+    batch.steps.resize(numIdleBins);
+    batch.reachTime.resize(numIdleBins);
+    batch.waitTime.resize(numIdleBins);
+    batch.returnTime.resize(numIdleBins);
+    for (int i = 0; i < numIdleBins; ++i) {
+        const BinScore &s = scores[idle.binId[i]];
+        batch.steps[i] = s.steps;
+        batch.reachTime[i] = s.reachTime;
+        batch.waitTime[i] = s.waitTime;
+        batch.returnTime[i] = s.returnTime;
+    }
     
-    printf("A%d plans:\n", id);
-    for (int i = 0; i < (int) plans.size(); ++i)
-        printf("P%d -> B%d, score: %f\n", i, plans[i].binId, plans[i].value);
+    // Best bin sequences for every first bin, already in ascending value
+    double deadline = (planBudget > 0) ? start + planBudget * 1e-6 : 0;
+    search.search(batch, depth, PLANS_PER_BIN, MAX_PLAN_NODES, deadline);
+    planTime = (planClock() - start) * 1e6;
+    planCut = search.isTimedOut();
+    
+    // Go one layer shallower after a cut; go deeper when a search with one more bin per layer would still fit
+    if (planBudget > 0) {
+        int branching = (numIdleBins < 2) ? 2 : numIdleBins;
+        if (planCut && depth > 1)
+            --depth;
+        else if (!planCut && depth < numLayers && planTime * branching < planBudget)
+            ++depth;
+    }
+    for (int i = 0; i < search.size(); ++i) {
+        plans.push_back(Plan(idle.binId[search[i].first], search[i].value));
+#ifdef ORCHARD_DEBUG
+        std::vector<int> binPath(numLayers, -1);
+        for (int j = 0; j < search.getPathLength(); ++j)
+            binPath[j] = idle.index[search.getPath(i)[j]];
+        float reference = calcPathValues(&binPath[0], world, world.getOrchard());
+        float value = search[i].value;
+        if (!(value == reference || (value != value && reference != reference)))
+            LOG_WARN(LOG_PLAN, "A%d plan %d: batch score %f != %f\n", id, i, value, reference);
+#endif
+    }
 }
 
-void AutoAgent::removePlan(int binId)
+void AutoAgent::printPlans() const
 {
-    for (int p = 0; p < (int) plans.size(); ++p) {
-        if (plans[p].binId == binId) {
-            plans.erase(plans.begin() + p);
-            --p;
-        }
-    }
+    if (numIdleSeen == -1)
+        return;
+    LOG_DEBUG(LOG_PLAN, "A%d sees %d idle bins.\n", id, numIdleSeen);
+    if (numIdleSeen == 0)
+        return;
+    LOG_DEBUG(LOG_PLAN, "A%d plans:\n", id);
+    for (int i = 0; i < (int) plans.size(); ++i)
+        LOG_DEBUG(LOG_PLAN, "P%d -> B%d, score: %f\n", i, plans[i].binId, plans[i].value);
 }
 
-void AutoAgent::selectPlan(std::vector<AutoAgent> &agents, std::vector<AppleBin> bins)
+void AutoAgent::selectPlan(const AuctionEngine &auction, const AutoWorld &world)
 {
-    printf("A%d has %d plans.\n", id, (int) plans.size());
+    LOG_DEBUG(LOG_PLAN, "A%d has %d plans.\n", id, auction.getNumOpenBids(id));
     
-    if (plans.size() == 0)
+    int binId = auction.getBin(id);
+    if (binId == -1)
         return;
     
-    for (int p = 0; p < (int) plans.size(); ++p) {
-        int minId = -1;
-        float minVal = FLT_MAX;
-        for (int a = 0; a < (int) agents.size(); ++a) {
-            if (agents[a].id == id || agents[a].plans.size() == 0 || agents[a].plans[0].binId != plans[p].binId)
-                continue;
-            if (agents[a].plans[0].value < minVal) {
-                minId = agents[a].id;
-                minVal = agents[a].plans[0].value;
-            }
-        }
-        
-        if (minId == -1 || (minId != -1 && plans[p].value <= minVal)) {
-            activePlan.binId = plans[p].binId;
-            activePlan.value = plans[p].value;
-            // Set target bin ID and location
-            int idx = getBinIndexById(bins, activePlan.binId);
-            targetBinId = plans[p].binId;
-            targetLoc = (bins[idx].onGround) ? bins[idx].loc : getCarrierDestination(bins[idx], agents);
-            printf("A%d select plan: B%d at (%d,%d) (score: %4.2f).\n", id, targetBinId, targetLoc.x, targetLoc.y, 
-                activePlan.value);
-            // Broadcast to other agents that the bin is taken
-            for (int a = 0; a < (int) agents.size(); ++a) {
-                if (agents[a].id != id)
-                    agents[a].removePlan(targetBinId);
-            }
-            return;
-        }
-    }
-}
-
-bool AutoAgent::areSameStates(AutoState s1, AutoState s2)
-{
-    if (s1.binStepCount == s2.binStepCount && s1.locStepCount == s2.locStepCount 
-        && s1.binToLocStepCount == s2.binToLocStepCount && s1.binEstFullTime == s2.binEstFullTime)
-        return true;
-    return false;
+    const BinStore &bins = world.getBins();
+    activePlan.binId = binId;
+    activePlan.value = auction.getValue(id);
+    // Set target bin ID and location
+    int idx = bins.indexOf(activePlan.binId);
+    targetBinId = binId;
+    setTargetLoc((bins[idx].onGround) ? bins[idx].loc : getCarrierDestination(bins[idx], world.getAgents()));
+    LOG_DEBUG(LOG_PLAN, "A%d select plan: B%d at (%d,%d) (score: %4.2f).\n", id, targetBinId, targetLoc.x, targetLoc.y, 
+        activePlan.value);
 }
 
 int AutoAgent::getStateIndex(AutoState s)
 {
-    for (int i = 0; i < (int) states.size(); ++i) {
-        if (areSameStates(states[i], s))
-            return i;
-    }
-    return -1;
+    return states.find(s);
 }
 
-bool AutoAgent::hasBin(Coordinate loc, std::vector<AppleBin> bins)
+bool AutoAgent::isLocationServed(Coordinate loc, const AutoWorld &world)
 {
-    for (int i = 0; i < (int) bins.size(); ++i) {
-        if (bins[i].loc.x == loc.x && bins[i].loc.y == loc.y && bins[i].onGround)
-            return true;
+    const RequestQueue &requests = world.getRequests();
+    if (world.getAgents().size() == 0)
+        return false;
+    
+    // Reported as if checking agent by agent, where a bin on the ground is noticed right after the first agent
+    bool isActive;
+    int a = requests.getServingAgent(loc, &isActive);
+    if (a != 0 && requests.hasGroundBin(loc)) {
+        LOG_DEBUG(LOG_AGENT, "[A%d] sees a bin at (%d,%d)\n", id, loc.x, loc.y);
+        return true;
     }
-    
-    return false;
+    if (a == -1)
+        return false;
+    if (isActive)
+        LOG_DEBUG(LOG_AGENT, "[A%d] A%d activeLoc: (%d,%d)\n", id, a, activeLocation.x, activeLocation.y);
+    else
+        LOG_DEBUG(LOG_AGENT, "[A%d] A%d targetLoc: (%d,%d)\n", id, a, targetLoc.x, targetLoc.y);
+    return true;
 }
 
-bool AutoAgent::isLocationServed(Coordinate loc, std::vector<AutoAgent> agents, std::vector<AppleBin> bins)
+Coordinate AutoAgent::selectClosestLocationRequest(Coordinate loc, const AutoWorld &world)
 {
-    for (int a = 0; a < (int) agents.size(); ++a) {
-        if (agents[a].activeLocation.x == loc.x && agents[a].activeLocation.y == loc.y) {
-            printf("[A%d] A%d activeLoc: (%d,%d)\n", id, agents[a].id, activeLocation.x, activeLocation.y);
-            return true;
-        }
-        if (agents[a].targetLoc.x == loc.x && agents[a].targetLoc.y == loc.y) {
-            printf("[A%d] A%d targetLoc: (%d,%d)\n", id, agents[a].id, targetLoc.x, targetLoc.y);
-            return true;
-        }
-        if (hasBin(loc, bins)) {
-            printf("[A%d] sees a bin at (%d,%d)\n", id, loc.x, loc.y);
-            return true;
-        }
+    // Only unserved requests are candidates; the others are reported in request order
+    const RequestQueue &requests = world.getRequests();
+    reqLocs.clear();
+    for (int r = requests.first(); r != -1; r = requests.next(r)) {
+        if (!isLocationServed(requests.get(r).loc, world))
+            reqLocs.push_back(requests.get(r).loc);
     }
-    return false;
-}
-
-Coordinate AutoAgent::selectClosestLocationRequest(Coordinate loc, std::vector<LocationRequest> requests, 
-    std::vector<AutoAgent> agents, std::vector<AppleBin> bins)
-{
+    if (reqLocs.empty())
+        return Coordinate(-1, -1);
+    
+    oracle->getStepCounts(curLoc, reqLocs, curSteps);
+    bool hasLoc = (loc.x != -1 && loc.y != -1);
+    if (hasLoc)
+        oracle->getStepCounts(loc, reqLocs, locSteps);
+    int repoSteps = hasLoc ? oracle->getStepCount(loc, Coordinate(0, loc.y)) : 0;
+    
     int minIdx = -1;
     int minStep = INT_MAX;
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (isLocationServed(requests[i].loc, agents, bins)) {
-            continue;
-        }
-        
-        //int tmp = getStepCount(loc, requests[i].loc);
-        
-        int tmp = getStepCount(curLoc, requests[i].loc);
-        if (loc.x != -1 && loc.y != -1)
-            tmp += getStepCount(loc, requests[i].loc) + getStepCount(loc, Coordinate(0, loc.y));
+    for (int i = 0; i < (int) reqLocs.size(); ++i) {
+        int tmp = curSteps[i];
+        if (hasLoc)
+            tmp += locSteps[i] + repoSteps;
         else
-            tmp += getStepCount(curLoc, requests[i].loc);
+            tmp += curSteps[i];
         if (tmp < minStep) {
             minIdx = i;
             minStep = tmp;
         }
     }
     
-    if (requests.size() == 0 || minIdx == -1) {
-        return Coordinate(-1, -1);
-    }
-    
-    return requests[minIdx].loc;
+    return reqLocs[minIdx];
 }
 
-Coordinate AutoAgent::selectLocationRequest(std::vector<LocationRequest> requests, AppleBin ab, 
-    std::vector<AutoAgent> agents, int *stateIndex, std::vector<AppleBin> bins)
+Coordinate AutoAgent::selectLocationRequest(const AppleBin *ab, const AutoWorld &world, int *stateIndex)
 {
+    const RequestQueue &requests = world.getRequests();
     if (requests.size() == 0)
         return Coordinate(-1, -1);
     
     std::vector<int> tmpIndexes;
     std::vector<int> reqIndexes;
     std::vector<AutoState> tmpStates;
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (isLocationServed(requests[i].loc, agents, bins))
+    for (int i = requests.first(); i != -1; i = requests.next(i)) {
+        if (isLocationServed(requests.get(i).loc, world))
             continue;
-        int binSC = (targetBinId == -1) ? 0 : getStepCount(curLoc, targetLoc);
-        int locSC = getStepCount(curLoc, requests[i].loc);
-        int diffSC = (targetBinId == -1) ? 0 : getStepCount(targetLoc, requests[i].loc);
-        float remCapacity = BIN_CAPACITY - round(ab.capacity);
-        int estTime = ceil(remCapacity / ab.fillRate);
-        AutoState s = AutoState(binSC, locSC, diffSC, estTime);
-        int idx = getStateIndex(s);
-        if (idx == -1) { // add new state to learning vector
-            states.push_back(s);
-            idx = states.size() - 1;
+        int binSC = (targetBinId == -1) ? 0 : oracle->getStepCount(curLoc, targetLoc);
+        int locSC = oracle->getStepCount(curLoc, requests.get(i).loc);
+        int diffSC = (targetBinId == -1) ? 0 : oracle->getStepCount(targetLoc, requests.get(i).loc);
+        int estTime = NO_FILL_TIME;
+        if (ab != NULL && ab->fillRate > 0) {
+            float remCapacity = BIN_CAPACITY - round(ab->capacity);
+            estTime = ceil(remCapacity / ab->fillRate);
         }
-        s.reward = states[idx].reward;
+        AutoState s = AutoState(binSC, locSC, diffSC, estTime);
+        int idx = states.insert(s); // New states join the learning table
+        s.reward = states.getReward(idx);
         tmpIndexes.push_back(idx);
         tmpStates.push_back(s);
         reqIndexes.push_back(i);
@@ -389,16 +533,12 @@ Coordinate AutoAgent::selectLocationRequest(std::vector<LocationRequest> request
     }
     
     (*stateIndex) = tmpIndexes[maxIdx];
-    return requests[reqIndexes[maxIdx]].loc;
+    return requests.get(reqIndexes[maxIdx]).loc;
 }
 
-bool AutoAgent::isLocationValid(Coordinate l)
-{
-    return (l.x >= 0 && l.x < ORCH_COLS && l.y >= 0 && l.y < ORCH_ROWS);
-}
-
-void AutoAgent::move(Coordinate loc, std::vector<AppleBin> &bins, int index)
+void AutoAgent::move(Coordinate loc, AutoWorld &world, int index)
 {
+    const BinStore &bins = world.getBins();
     if (!isLocationValid(loc))
         return;
     
@@ -406,66 +546,22 @@ void AutoAgent::move(Coordinate loc, std::vector<AppleBin> &bins, int index)
     if (curBinId != -1 && index != -1 && bins[index].capacity > 0)
         speed = AGENT_SPEED_L;
     
-    for (int s = 0; s < speed; ++s) {
-        if (loc.x == 0) { // Target location is the repo
-            if (curLoc.x != loc.x)
-                curLoc.x = (curLoc.x - 1 <= loc.x) ? loc.x : curLoc.x - 1; // Move left
-        } else {
-            if (curLoc.y == loc.y) {
-                if (loc.x > curLoc.x)
-                    curLoc.x = (curLoc.x + 1 >= loc.x) ? loc.x : curLoc.x + 1; // Move right
-                else
-                    curLoc.x = (curLoc.x - 1 <= loc.x) ? loc.x : curLoc.x - 1; // Move left
-            } else { // Need to travel between rows
-                if (curLoc.x == 0 || curLoc.x == ORCH_COLS - 1) { // At left/rightmost column; can travel between rows
-                    if (loc.y > curLoc.y)
-                        curLoc.y = (curLoc.y + 1 >= loc.y) ? loc.y : curLoc.y + 1; // Move down
-                    else
-                        curLoc.y = (curLoc.y - 1 <= loc.y) ? loc.y : curLoc.y - 1; // Move up
-                } else {
-                    int leftDist = curLoc.x;
-                    int rightDist = ORCH_COLS - 1 - curLoc.x;
-                    if (leftDist < rightDist) // Travel between rows through the leftmost column
-                        curLoc.x = (curLoc.x - 1 <= loc.x) ? curLoc.x - 1 : loc.x; // Move left
-                    else
-                        curLoc.x = (curLoc.x + 1 >= loc.x) ? curLoc.x + 1 : loc.x; // Move right
-                }
-            }
-        }
-    }
+    curLoc = oracle->advance(curLoc, loc, speed);
     
     if (index >= 0 && index < (int) bins.size())
-        bins[index].loc = curLoc;
-}
-
-void AutoAgent::removeLocationRequest(Coordinate loc, std::vector<LocationRequest> &requests)
-{
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (requests[i].loc.x == loc.x && requests[i].loc.y == loc.y) {
-            requests.erase(requests.begin() + i);
-            --i;
-        }
-    }
+        world.moveBin(index, curLoc);
 }
 
-int AutoAgent::getRequestTime(Coordinate loc, std::vector<LocationRequest> requests)
-{
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (requests[i].loc.x == loc.x && requests[i].loc.y == loc.y)
-            return requests[i].regisTime;
-    }
-    return -1;
-}
-
-float AutoAgent::getCFReward(std::vector<LocationRequest> requests, AppleBin ab)
+float AutoAgent::getCFReward(const RequestQueue &requests, const AppleBin &ab)
 {
     float sum = 0;
     float count = 0;
-    for (int i = 0; i < (int) requests.size(); ++i) {
-        if (requests[i].regisTime > lastDecisionTime)
+    for (int i = requests.first(); i != -1; i = requests.next(i)) {
+        const LocationRequest &req = requests.get(i);
+        if (req.regisTime > lastDecisionTime)
             continue;
-        float hTime = ((float) getStepCount(lastDecisionLoc, requests[i].loc)) / AGENT_SPEED_H;
-        float bTime = hTime + ((float) getStepCount(requests[i].loc, ab.loc)) / AGENT_SPEED_H;
+        float hTime = ((float) oracle->getStepCount(lastDecisionLoc, req.loc)) / AGENT_SPEED_H;
+        float bTime = hTime + ((float) oracle->getStepCount(req.loc, ab.loc)) / AGENT_SPEED_H;
         sum += -(hTime * C_H + bTime + C_B);
         count++;
     }
@@ -473,28 +569,31 @@ float AutoAgent::getCFReward(std::vector<LocationRequest> requests, AppleBin ab)
     return sum / count;
 }
 
-void AutoAgent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector<LocationRequest> &requests, 
-    std::vector<AutoAgent> &agents, std::vector<AppleBin> &repo, Orchard env, std::vector<Worker> workers, int curTime)
+void AutoAgent::takeAction(AutoWorld &world, int curTime)
 {
+    const BinStore &bins = world.getBins();
+    const Orchard &env = world.getOrchard();
+    const RequestQueue &requests = world.getRequests();
     bool moved = false;
     
-    int tIdx = getBinIndexById(bins, targetBinId);
+    int tIdx = bins.indexOf(targetBinId);
     if (tIdx != -1 && curLoc.x == 0) {
         float remainingApples = env.getApplesAt(bins[tIdx].loc);
-        float fillRate = countWorkersAt(targetLoc, workers) * PICK_RATE;
+        float fillRate = world.countWorkersAt(targetLoc) * PICK_RATE;
         float remainingCap = BIN_CAPACITY - bins[tIdx].capacity;
-        float harvestedApples = fillRate * (getStepCount(curLoc, bins[tIdx].loc) + 1);
-        printf("ra: %4.2f, fr: %4.2f, rc: %4.2f, ha: %4.2f\n", remainingApples, fillRate, remainingCap, harvestedApples);
+        float harvestedApples = fillRate * (oracle->getStepCount(curLoc, bins[tIdx].loc) + 1);
+        LOG_DEBUG(LOG_LEARN, "ra: %4.2f, fr: %4.2f, rc: %4.2f, ha: %4.2f\n", remainingApples, fillRate, remainingCap, 
+            harvestedApples);
         harvestedApples = (harvestedApples > remainingCap) ? remainingCap : harvestedApples;
         if (bins[tIdx].onGround)
             remainingApples -= harvestedApples;
-        printf("ha: %4.2f, ra: %4.2f\n", harvestedApples, remainingApples);
+        LOG_DEBUG(LOG_LEARN, "ha: %4.2f, ra: %4.2f\n", harvestedApples, remainingApples);
         if (curBinId == -1 && bins[tIdx].onGround && remainingApples > 0) {
-            curBinId = (*binCounter)++;
-            bins.push_back(AppleBin(curBinId, curLoc.x, curLoc.y));
-            activeLocation = targetLoc;
-            printf("A%d takes a new bin B%d to (%d,%d). targetBin: %d, tIdx: %d, TargetLoc: (%d,%d) (*)\n", id, curBinId, 
-                activeLocation.x, activeLocation.y, targetBinId, tIdx, targetLoc.x, targetLoc.y);
+            curBinId = world.createBin(curLoc);
+            setActiveLocation(targetLoc);
+            LOG_DEBUG(LOG_AGENT, "A%d takes a new bin B%d to (%d,%d). targetBin: %d, tIdx: %d, "
+                "TargetLoc: (%d,%d) (*)\n", id, curBinId, activeLocation.x, activeLocation.y, targetBinId, tIdx, 
+                targetLoc.x, targetLoc.y);
             // save history for calculating reward
             lastDecisionTime = curTime;
             lastDecisionLoc = curLoc;
@@ -503,11 +602,12 @@ void AutoAgent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::ve
     }
     
     if (activeStateIndex == -1 && curLoc.x == 0 && curBinId == -1 && requests.size() > 0) {
+        const AppleBin *target = (tIdx != -1) ? &bins[tIdx] : NULL;
         if (useLearning)
-            activeLocation = selectLocationRequest(requests, bins[tIdx], agents, &activeStateIndex, bins);
+            setActiveLocation(selectLocationRequest(target, world, &activeStateIndex));
         else
-            activeLocation = selectClosestLocationRequest(bins[tIdx].loc, requests, agents, bins);
-        printf("A%d selects location request (%d,%d).\n", id, activeLocation.x, activeLocation.y);
+            setActiveLocation(selectClosestLocationRequest((target != NULL) ? target->loc : Coordinate(-1, -1), world));
+        LOG_DEBUG(LOG_AGENT, "A%d selects location request (%d,%d).\n", id, activeLocation.x, activeLocation.y);
         // save history for calculating reward
         lastDecisionTime = curTime;
         lastDecisionLoc = curLoc;
@@ -516,30 +616,29 @@ void AutoAgent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::ve
     
     if (isLocationValid(activeLocation) && !(activeLocation.x == targetLoc.x && activeLocation.y == targetLoc.y)) {
         if (curBinId == -1 && curLoc.x == 0) { // get a new bin
-            curBinId = (*binCounter)++;
-            bins.push_back(AppleBin(curBinId, curLoc.x, curLoc.y));
-            printf("A%d takes a new bin B%d to (%d,%d). (**)\n", id, curBinId, activeLocation.x, activeLocation.y);
+            curBinId = world.createBin(curLoc);
+            LOG_DEBUG(LOG_AGENT, "A%d takes a new bin B%d to (%d,%d). (**)\n", id, curBinId, activeLocation.x, 
+                activeLocation.y);
         }
         
-        int cIdx = getBinIndexById(bins, curBinId);
+        int cIdx = bins.indexOf(curBinId);
         if ( (curLoc.x != activeLocation.x || curLoc.y != activeLocation.y) && !moved) {
-            move(activeLocation, bins, cIdx);
-            printf("A%d moves to (%d,%d). Active location: (%d,%d). (+)\n", id, curLoc.x, curLoc.y, activeLocation.x, 
-                activeLocation.y);
+            move(activeLocation, world, cIdx);
+            LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). Active location: (%d,%d). (+)\n", id, curLoc.x, curLoc.y, 
+                activeLocation.x, activeLocation.y);
             moved = true;
         }
         
         if (curLoc.x == activeLocation.x && curLoc.y == activeLocation.y) {
             if (curBinId != -1) { // arrived at requested location; drop the new bin
-                bins[cIdx].loc = curLoc;
-                bins[cIdx].onGround = true;
-                printf("A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[cIdx].id, 
+                world.dropBin(cIdx, curLoc);
+                LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[cIdx].id, 
                     bins[cIdx].loc.x, bins[cIdx].loc.y);
-                int regisTime = getRequestTime(activeLocation, requests);
+                int regisTime = requests.getRegisTime(activeLocation);
                 humanWaitTime = (regisTime == -1) ? 0 : curTime - regisTime;
                 curBinId = -1;
                 cIdx = -1;
-                activeLocation = Coordinate(-1, -1); // reset
+                setActiveLocation(Coordinate(-1, -1)); // reset
             }
         }
     }
@@ -548,48 +647,49 @@ void AutoAgent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::ve
         if (curLoc.x == targetLoc.x && curLoc.y == targetLoc.y) { // arrived at target bin location
             if (round(bins[tIdx].capacity) >= BIN_CAPACITY) { // bin is full; pick it up
                 // Drop the new bin
-                int nIdx = getBinIndexById(bins, curBinId);
+                int nIdx = bins.indexOf(curBinId);
                 if (curLoc.x == activeLocation.x && curLoc.y == activeLocation.y && curBinId != -1) {
-                    bins[nIdx].loc = curLoc;
-                    bins[nIdx].onGround = true;
-                    printf("A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[nIdx].id, 
+                    world.dropBin(nIdx, curLoc);
+                    LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) drops B%d at (%d,%d).\n", id, curLoc.x, curLoc.y, bins[nIdx].id, 
                         bins[nIdx].loc.x, bins[nIdx].loc.y);
-                    int regisTime = getRequestTime(activeLocation, requests);
+                    int regisTime = requests.getRegisTime(activeLocation);
                     humanWaitTime = (regisTime == -1) ? 0 : curTime - regisTime;
                     curBinId = -1;
-                    activeLocation = Coordinate(-1, -1); // reset
+                    setActiveLocation(Coordinate(-1, -1)); // reset
                 }
                 // Then, pick up the full bin
                 curBinId = targetBinId;
-                int cIdx = getBinIndexById(bins, curBinId);
-                bins[cIdx].onGround = false;
+                int cIdx = bins.indexOf(curBinId);
+                world.pickUpBin(cIdx);
                 targetBinId = -1; // reset
-                targetLoc.x = 0; // destination is set to repo
-                printf("A%d picks up B%d at (%d,%d). Current destination: Repo (%d,%d).\n", id, curBinId, 
+                setTargetLoc(Coordinate(0, targetLoc.y)); // destination is set to repo
+                LOG_DEBUG(LOG_AGENT, "A%d picks up B%d at (%d,%d). Current destination: Repo (%d,%d).\n", id, curBinId, 
                     curLoc.x, curLoc.y, targetLoc.x, targetLoc.y);
                 binWaitTime = (bins[cIdx].filledTime == -1) ? 0 : curTime - bins[cIdx].filledTime;
             } else { // bin is not full yet; wait
                 if (targetBinId != -1) {
-                    printf("A%d(%d,%d) waits for B%d(%d,%d) to be full. TargetLoc: (%d,%d).\n", id, curLoc.x, curLoc.y, 
-                        targetBinId, bins[tIdx].loc.x, bins[tIdx].loc.y, targetLoc.x, targetLoc.y);
+                    LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) waits for B%d(%d,%d) to be full. TargetLoc: (%d,%d).\n", id, 
+                        curLoc.x, curLoc.y, targetBinId, bins[tIdx].loc.x, bins[tIdx].loc.y, targetLoc.x, targetLoc.y);
                 }
                 return;
             }
         }
     } else { // no active location request and no target bin; return to repo
-        targetLoc.x = 0;
+        setTargetLoc(Coordinate(0, targetLoc.y));
         if (isLocationValid(targetLoc) && !moved) {
-            int cIdx = getBinIndexById(bins, curBinId);
-            move(targetLoc, bins, cIdx);
-            printf("A%d moves to (%d,%d). TargetLoc: (%d,%d). (++)\n", id, curLoc.x, curLoc.y, targetLoc.x, targetLoc.y);
+            int cIdx = bins.indexOf(curBinId);
+            move(targetLoc, world, cIdx);
+            LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). TargetLoc: (%d,%d). (++)\n", id, curLoc.x, curLoc.y, 
+                targetLoc.x, targetLoc.y);
             moved = true;
         }
     }
     
-    int idx = getBinIndexById(bins, curBinId);
+    int idx = bins.indexOf(curBinId);
     if (isLocationValid(targetLoc) && !moved) {
-        move(targetLoc, bins, idx);
-        printf("A%d moves to (%d,%d). TargetLoc: (%d,%d). (+++)\n", id, curLoc.x, curLoc.y, targetLoc.x, targetLoc.y);
+        move(targetLoc, world, idx);
+        LOG_DEBUG(LOG_AGENT, "A%d moves to (%d,%d). TargetLoc: (%d,%d). (+++)\n", id, curLoc.x, curLoc.y, targetLoc.x, 
+            targetLoc.y);
         moved = true;
     }
     
@@ -599,16 +699,15 @@ void AutoAgent::takeAction(int *binCounter, std::vector<AppleBin> &bins, std::ve
                 float rA = -(humanWaitTime * C_H + binWaitTime * C_B);
                 float rCF = getCFReward(requests, bins[idx]);
                 float reward = rA - rCF;
-                states[activeStateIndex].reward += reward; 
+                states.addReward(activeStateIndex, reward); 
             }
             // Put carried bin in repo
-            repo.push_back(copyBin(bins[idx]));
-            printf("A%d(%d,%d) put B%d in Repo.\n", id, curLoc.x, curLoc.y, curBinId);
-            bins.erase(bins.begin() + idx);
+            LOG_DEBUG(LOG_AGENT, "A%d(%d,%d) put B%d in Repo.\n", id, curLoc.x, curLoc.y, curBinId);
+            world.deliverBin(idx, copyBin(bins[idx]));
             // Reset all
             curBinId = -1;
             targetBinId = -1;
-            targetLoc = Coordinate(-1, -1);
+            setTargetLoc(Coordinate(-1, -1));
             activeStateIndex = -1;
             lastDecisionTime = -1;
             lastDecisionLoc = Coordinate(-1, -1);
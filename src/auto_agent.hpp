@@ -5,6 +5,11 @@
 #include "params.hpp"
 #include "data_structs.hpp"
 #include "orchard.hpp"
+#include "bin_store.hpp"
+#include "plan_kernel.hpp"
+#include "world_view.hpp"
+#include "auction.hpp"
+#include "state_table.hpp"
 
 struct Plan {
     int binId;
@@ -12,79 +17,136 @@ struct Plan {
     Plan(int b = -1, float v = 0) : binId(b), value(v) {}
 };
 
-struct AutoState {
-    int binStepCount;
-    int locStepCount;
-    int binToLocStepCount;
-    int binEstFullTime; // estimated time until the bin is full
-    float reward;
-    AutoState(int b, int l, int d, int e, float r = 0) 
-        : binStepCount(b), locStepCount(l), binToLocStepCount(d), binEstFullTime(e), reward(r) {}
+/*
+ * The bins idle agents may plan for in one tick, packed once and shared by every agent that plans (the idle bins
+ * are the same for every idle agent). Each update compares a bin's packed inputs with the previous update's: a
+ * bin whose location, capacity, fill rate or apples changed, or that was not idle before, gets a new stamp, and
+ * any change at all bumps the version. Agents rescore only bins whose stamp moved and keep their plans while the
+ * version and their own cell stay the same.
+ */
+struct IdleBinSet
+{
+    struct Inputs
+    {
+        int x;
+        int y;
+        float capacity;
+        float fillRate;
+        float apples;
+        int seen; // Last update the bin was idle in
+        int stamp; // Update its inputs last changed in
+        Inputs() : x(-1), y(-1), capacity(0), fillRate(0), apples(0), seen(-1), stamp(-1) {}
+    };
+    
+    std::vector<int> index; // Bin index of each slot
+    std::vector<int> binId;
+    std::vector<int> stamp;
+    BinBatch batch; // Inputs only, slot for slot
+    std::vector<Inputs> last; // By bin id
+    int updates;
+    int version;
+    
+    IdleBinSet() : updates(0), version(0) {}
+    
+    int size() const { return (int) index.size(); }
 };
 
+class AutoAgent;
+
+typedef WorldView<AutoAgent> AutoWorld;
+
 class AutoAgent
 {
 public:
     static const float C_H;
     static const float C_B;
     
-    AutoAgent(int i, Coordinate c, int n, bool learn = false);
+    AutoAgent(int i, Coordinate c, int n, const Orchard &env, bool learn = false);
     
     ~AutoAgent();
     
-    int getId() { return id; }
+    int getId() const { return id; }
     
     void setCurLoc(Coordinate loc) { curLoc = loc; }
     
-    Coordinate getCurLoc() { return curLoc; }
+    Coordinate getCurLoc() const { return curLoc; }
+    
+    Coordinate getTargetLoc() const { return targetLoc; }
+    
+    int getCurBinId() const { return curBinId; }
+    
+    int getTargetBinId() const { return targetBinId; }
+    
+    const std::vector<Plan> &getPlans() const { return plans; }
+    
+    // Report this agent's active location and target to q from now on, so q knows which requests are served
+    void trackRequests(RequestQueue *q);
+    
+    Plan getActivePlan() const { return activePlan; }
     
-    Coordinate getTargetLoc() { return targetLoc; }
+    int getBinIndexByLoc(const BinStore &bins, Coordinate loc);
     
-    int getCurBinId() { return curBinId; }
+    // Bins no agent is busy with; only meaningful to agents that are idle themselves
+    static void getIdleBins(const AutoWorld &world, std::vector<int> &idleBins);
     
-    int getTargetBinId() { return targetBinId; }
+    // Called once per tick, before the agents plan
+    static void collectIdleBins(const AutoWorld &world, IdleBinSet &idle);
     
-    std::vector<Plan> getPlans() { return plans; }
+    // Whether no agent has anything to decide in the next tick: each one travels towards its target bin, its 
+    // location request or the repo, waits at a target bin that is not full yet, or is parked with no bin, no 
+    // target, no location request to serve and no idle bin to bid for. *parked tells whether any agent is parked; 
+    // trips gets what each agent does until it has something to decide again.
+    static bool isQuiet(const AutoWorld &world, bool *parked, std::vector<Trip> &trips);
     
-    Plan getActivePlan() { return activePlan; }
+    // Where ticks more ticks of the trip isQuiet gave take the agent and its bin
+    void followTrip(AutoWorld &world, const Trip &trip, int ticks);
     
-    int getBinIndexById(std::vector<AppleBin> bins, int id);
+    float calcWaitTime(const AppleBin &ab, const Orchard &env, float reachTime);
     
-    int getBinIndexByLoc(std::vector<AppleBin> bins, Coordinate loc);
+    // Scalar reference for the batch plan scoring in makePlans (checked against it with ORCHARD_DEBUG)
+    float calcPathValues(int binPath[], const AutoWorld &world, const Orchard &env);
     
-    std::vector<int> getIdleBins(std::vector<AutoAgent> agents, std::vector<AppleBin> bins);
+    // Anytime planning: each makePlans stops searching after us microseconds and adapts the lookahead depth to 
+    // what fits; 0 (the default) plans to full depth without a limit
+    void setPlanBudget(int us) { planBudget = us; }
     
-    int getStepCount(Coordinate src, Coordinate dst);
+    int getPlanDepth() const { return depth; }
     
-    float calcWaitTime(AppleBin ab, Orchard env, float reachTime, std::vector<AppleBin> bins);
+    // Time the last makePlans spent planning in microseconds, or -1 if it kept its plans or the agent was busy
+    double getPlanTime() const { return planTime; }
     
-    float calcPathValues(int binPath[], std::vector<AppleBin> bins, std::vector<AutoAgent> agents, Orchard env, 
-        std::vector<Worker> workers);
+    // Whether the budget cut the last makePlans short
+    bool wasPlanCut() const { return planCut; }
     
-    void makePlans(std::vector<AutoAgent> agents, std::vector<AppleBin> bins, Orchard env, std::vector<Worker> workers);
+    // Reads the world only and prints nothing, so agents can plan concurrently; see printPlans
+    void makePlans(const AutoWorld &world, const IdleBinSet &idle);
     
-    void selectPlan(std::vector<AutoAgent> &agents, std::vector<AppleBin> bins);
+    // What the last makePlans found, for printing in agent order
+    void printPlans() const;
+    
+    // Takes the bin the auction assigned to this agent, if any
+    void selectPlan(const AuctionEngine &auction, const AutoWorld &world);
     
     int getStateIndex(AutoState s);
     
-    void removeLocationRequest(Coordinate loc, std::vector<LocationRequest> &requests);
+    Coordinate selectClosestLocationRequest(Coordinate loc, const AutoWorld &world);
     
-    Coordinate selectClosestLocationRequest(Coordinate loc, std::vector<LocationRequest> requests, 
-        std::vector<AutoAgent> agents, std::vector<AppleBin> bins);
+    // ab is the target bin, or NULL if the agent has none
+    Coordinate selectLocationRequest(const AppleBin *ab, const AutoWorld &world, int *stateIndex);
     
-    Coordinate selectLocationRequest(std::vector<LocationRequest> requests, AppleBin ab, std::vector<AutoAgent> agents, 
-        int *stateIndex, std::vector<AppleBin> bins);
+    void move(Coordinate loc, AutoWorld &world, int index);
     
-    void move(Coordinate loc, std::vector<AppleBin> &bins, int index);
+    void takeAction(AutoWorld &world, int curTime);
     
-    void takeAction(int *binCounter, std::vector<AppleBin> &bins, std::vector<LocationRequest> &requests, 
-        std::vector<AutoAgent> &agents, std::vector<AppleBin> &repo, Orchard env, std::vector<Worker> workers, 
-        int curTime);
+    int getNumOfStates() { return states.size(); }
     
-    int getNumOfStates() { return (int) states.size(); }
+    // Learned states of all agents, for loading and saving between runs
+    static StateTable &getStates() { return states; }
     
 private:
     int id;
+    const DistanceOracle *oracle; // Owned by the orchard
+    RequestQueue *requestQueue; // Owned by the run loop; NULL until trackRequests
     int numLayers;
     bool useLearning;
     Coordinate curLoc;
@@ -94,31 +156,58 @@ private:
     Plan activePlan;
     Coordinate activeLocation;
     int activeStateIndex;
-    static std::vector<AutoState> states;
+    static StateTable states; // Learned states of all agents
     std::vector<Plan> plans;
+    int numIdleSeen; // Idle bins at the last makePlans, or -1 when the agent was busy
     int lastDecisionTime;
     Coordinate lastDecisionLoc;
     Coordinate lastActiveLoc;
     float binWaitTime;
     float humanWaitTime;
     
-    Coordinate getCarrierDestination(AppleBin ab, std::vector<AutoAgent> agents);
-    
-    int countWorkersAt(Coordinate loc, std::vector<Worker> workers);
-    
-    void removePlan(int binId);
-    
-    bool areSameStates(AutoState s1, AutoState s2);
-    
-    bool isLocationServed(Coordinate loc, std::vector<AutoAgent> agents, std::vector<AppleBin> bins);
-    
-    bool hasBin(Coordinate loc, std::vector<AppleBin> bins);
-    
-    bool isLocationValid(Coordinate l);
-    
-    int getRequestTime(Coordinate loc, std::vector<LocationRequest> requests);
-    
-    float getCFReward(std::vector<LocationRequest> requests, AppleBin ab);
+    // Scores of a bin for an agent at scoreLoc, valid while epoch and stamp match
+    struct BinScore
+    {
+        int epoch;
+        int stamp;
+        int steps;
+        float reachTime;
+        float waitTime;
+        float returnTime;
+        BinScore() : epoch(-1), stamp(-1), steps(0), reachTime(0), waitTime(0), returnTime(0) {}
+    };
+    
+    // Incremental planning state; see makePlans
+    int planVersion; // Idle set version the current plans were made for, or -1
+    Coordinate planLoc;
+    int planBudget; // Microseconds per makePlans, 0 for no limit
+    int depth; // Lookahead in use, at most numLayers
+    double planTime;
+    bool planCut;
+    int scoreEpoch; // Bumped whenever the agent scores from a new cell
+    Coordinate scoreLoc;
+    std::vector<BinScore> scores; // By bin id
+    
+    // Scratch space reused every tick
+    BinBatch batch;
+    BinBatch dirty;
+    std::vector<int> dirtySlots;
+    PathSearch search;
+    std::vector<Coordinate> reqLocs;
+    std::vector<int> curSteps;
+    std::vector<int> locSteps;
+    
+    static Coordinate getCarrierDestination(const AppleBin &ab, ConstSpan<AutoAgent> agents);
+    
+    void setActiveLocation(Coordinate loc);
+    
+    void setTargetLoc(Coordinate loc);
+    
+    bool isLocationServed(Coordinate loc, const AutoWorld &world);
+    
+    bool isLocationValid(Coordinate l) { return oracle->isValid(l); }
+    
+    float getCFReward(const RequestQueue &requests, const AppleBin &ab);
     
     AppleBin copyBin(AppleBin ab);
 };
@@ -0,0 +1,71 @@
+#include <cstddef>
+#include "bin_store.hpp"
+
+BinStore::BinStore()
+{
+    numDead = 0;
+}
+
+void BinStore::add(const AppleBin &ab)
+{
+    if (ab.id >= (int) idIndex.size())
+        idIndex.resize(ab.id + 1, -1);
+    if (ab.id >= 0)
+        idIndex[ab.id] = (int) items.size();
+    items.push_back(ab);
+    dead.push_back(0);
+}
+
+bool BinStore::removeById(int id)
+{
+    if (id < 0 || id >= (int) idIndex.size() || idIndex[id] == -1)
+        return false;
+    removeAt(idIndex[id]);
+    return true;
+}
+
+void BinStore::removeAt(int index)
+{
+    if (dead[index])
+        return;
+    int id = items[index].id;
+    if (id >= 0 && id < (int) idIndex.size() && idIndex[id] == index)
+        idIndex[id] = -1;
+    dead[index] = 1; // Tombstone; folded in by compact()
+    ++numDead;
+}
+
+int BinStore::indexOf(int id) const
+{
+    if (id < 0 || id >= (int) idIndex.size() || idIndex[id] == -1)
+        return -1;
+    return idIndex[id];
+}
+
+void BinStore::clear()
+{
+    items.clear();
+    dead.clear();
+    idIndex.clear();
+    numDead = 0;
+}
+
+void BinStore::compactNow()
+{
+    int n = 0;
+    for (int i = 0; i < (int) items.size(); ++i) {
+        if (dead[i])
+            continue;
+        if (n != i) {
+            items[n] = items[i];
+            dead[n] = 0;
+        }
+        int id = items[n].id;
+        if (id >= 0 && idIndex[id] == i)
+            idIndex[id] = n;
+        ++n;
+    }
+    items.erase(items.begin() + n, items.end());
+    dead.resize(n);
+    numDead = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef BIN_STORE_HPP_
+#define BIN_STORE_HPP_
+
+#include <vector>
+#include "data_structs.hpp"
+
+/*
+ * The bins in the field. Live bins are kept densely in insertion order, so the simulation visits them exactly as 
+ * it did in a plain vector, and bins[i] / size() iterate them. Lookup by bin id is O(1). Removal is amortized: 
+ * the bin leaves a tombstone that compact() folds away in one order-preserving pass, which costs no more than 
+ * the dense loop that follows it and keeps the order in which bins are harvested and picked up. Indices stay 
+ * valid until that pass. The non-const accessors compact on their own; const access never writes, so whoever 
+ * removes bins compacts before the store is read through a const reference again.
+ * 
+ * Bin ids are expected to come from a counter (0, 1, 2, ...), as binCounter hands them out.
+ */
+class BinStore
+{
+public:
+    BinStore();
+    
+    void add(const AppleBin &ab);
+    
+    // Remove the bin; false if it was already gone
+    bool removeById(int id);
+    
+    void removeAt(int index);
+    
+    // Dense index of the bin with the given id, or -1
+    int indexOf(int id) const;
+    
+    int size() const { return (int) items.size() - numDead; }
+    
+    bool empty() const { return size() == 0; }
+    
+    AppleBin &operator[](int i) { compact(); return items[i]; }
+    
+    const AppleBin &operator[](int i) const { return items[i]; }
+    
+    void clear();
+    
+    // Folds pending removals in
+    void compact() { if (numDead > 0) compactNow(); }
+
+private:
+    std::vector<AppleBin> items; // Dense storage
+    std::vector<unsigned char> dead; // Tombstones
+    std::vector<int> idIndex; // Bin id -> dense index, -1 once removed
+    int numDead;
+    
+    void compactNow();
+};
+
+#endif // BIN_STORE_HPP_
@@ -0,0 +1,202 @@
+#include <cstdlib>
+#include "cell_index.hpp"
+
+CellIndex::CellIndex()
+{
+    grid = NULL;
+    apples = NULL;
+    occupied = NULL;
+    built = NULL;
+    rowFree = NULL;
+    freeRows = NULL;
+    rows = cols = words = stride = 0;
+    numFree = 0;
+}
+
+CellIndex::~CellIndex()
+{
+    release();
+}
+
+void CellIndex::release()
+{
+    free(apples);
+    free(occupied);
+    free(built);
+    free(rowFree);
+    free(freeRows);
+}
+
+void CellIndex::attach(const float *g, int s, int r, int c, const int *rowCounts)
+{
+    release();
+    grid = g;
+    stride = s;
+    rows = r;
+    cols = c;
+    words = (cols + 63) / 64;
+    apples = (Word *) calloc((size_t) rows * words + 1, sizeof(Word));
+    occupied = (Word *) calloc((size_t) rows * words + 1, sizeof(Word));
+    built = (unsigned char *) calloc(rows + 1, 1);
+    rowFree = (int *) calloc(rows + 1, sizeof(int));
+    freeRows = (Word *) calloc(rows / 64 + 1, sizeof(Word));
+    numFree = 0;
+    for (int i = 0; i < rows; ++i)
+        setRowFree(i, rowCounts[i]);
+}
+
+void CellIndex::setRowFree(int row, int count) const
+{
+    numFree += count - rowFree[row];
+    rowFree[row] = count;
+    Word rowBit = (Word) 1 << (row & 63);
+    if (count > 0)
+        freeRows[row >> 6] |= rowBit;
+    else
+        freeRows[row >> 6] &= ~rowBit;
+}
+
+int CellIndex::builtRow(int row) const
+{
+    if (built[row])
+        return row;
+    
+    // First touch: read the row's apples from the grid and recount its free cells
+    Word *a = apples + (size_t) row * words;
+    const Word *o = occupied + (size_t) row * words;
+    const float *cells = grid + (size_t) row * stride;
+    for (int j = 1; j < cols - 1; ++j) {
+        if (cells[j] > 0)
+            a[j >> 6] |= (Word) 1 << (j & 63);
+    }
+    int count = 0;
+    for (int w = 0; w < words; ++w)
+        count += __builtin_popcountll(a[w] & ~o[w]);
+    setRowFree(row, count);
+    built[row] = 1;
+    return row;
+}
+
+void CellIndex::updateBit(Word *bits, Coordinate loc, bool value)
+{
+    builtRow(loc.y);
+    bool wasFree = isFree(loc);
+    Word &w = bits[(size_t) loc.y * words + (loc.x >> 6)];
+    Word bit = (Word) 1 << (loc.x & 63);
+    w = value ? (w | bit) : (w & ~bit);
+    bool nowFree = isFree(loc);
+    if (wasFree != nowFree)
+        setRowFree(loc.y, rowFree[loc.y] + (nowFree ? 1 : -1));
+}
+
+void CellIndex::setHasApples(Coordinate loc, bool hasApples)
+{
+    if (isIndexed(loc))
+        updateBit(apples, loc, hasApples);
+}
+
+void CellIndex::setOccupied(Coordinate loc, bool isOccupied)
+{
+    if (isIndexed(loc))
+        updateBit(occupied, loc, isOccupied);
+}
+
+int CellIndex::findNext(const Word *mask, int row, int from, int to) const
+{
+    if (row < 0 || row >= rows)
+        return -1;
+    from = (from < 1) ? 1 : from;
+    to = (to > cols - 2) ? cols - 2 : to;
+    if (from > to)
+        return -1;
+    
+    const Word *bits = apples + (size_t) builtRow(row) * words;
+    const Word *masked = (mask == NULL) ? NULL : mask + (size_t) row * words;
+    int w = from >> 6;
+    Word cur = bits[w] & (~(Word) 0 << (from & 63));
+    if (masked != NULL)
+        cur &= ~masked[w];
+    while (true) {
+        if (cur != 0) {
+            int col = (w << 6) + __builtin_ctzll(cur);
+            return (col <= to) ? col : -1;
+        }
+        if (++w > (to >> 6))
+            return -1;
+        cur = bits[w];
+        if (masked != NULL)
+            cur &= ~masked[w];
+    }
+}
+
+int CellIndex::findNextFree(int row, int from, int to) const
+{
+    return findNext(occupied, row, from, to);
+}
+
+int CellIndex::findNextWithApples(int row, int from, int to) const
+{
+    return findNext(NULL, row, from, to);
+}
+
+int CellIndex::findPrevFree(int row, int from, int to) const
+{
+    if (row < 0 || row >= rows)
+        return -1;
+    from = (from > cols - 2) ? cols - 2 : from;
+    to = (to < 1) ? 1 : to;
+    if (from < to)
+        return -1;
+    
+    const Word *bits = apples + (size_t) builtRow(row) * words;
+    const Word *masked = occupied + (size_t) row * words;
+    int w = from >> 6;
+    Word cur = (bits[w] & ~masked[w]) & (~(Word) 0 >> (63 - (from & 63)));
+    while (true) {
+        if (cur != 0) {
+            int col = (w << 6) + 63 - __builtin_clzll(cur);
+            return (col >= to) ? col : -1;
+        }
+        if (--w < (to >> 6))
+            return -1;
+        cur = bits[w] & ~masked[w];
+    }
+}
+
+int CellIndex::findNextFreeRow(int from) const
+{
+    from = (from < 0) ? 0 : from;
+    while (from < rows) {
+        int w = from >> 6;
+        Word cur = freeRows[w] & (~(Word) 0 << (from & 63));
+        while (cur == 0) {
+            if (++w > (rows - 1) >> 6)
+                return -1;
+            cur = freeRows[w];
+        }
+        int row = (w << 6) + __builtin_ctzll(cur);
+        if (rowFree[builtRow(row)] > 0) // Building the row confirms the count it started with
+            return row;
+        from = row + 1;
+    }
+    return -1;
+}
+
+int CellIndex::findPrevFreeRow(int from) const
+{
+    from = (from >= rows) ? rows - 1 : from;
+    while (from >= 0) {
+        int w = from >> 6;
+        Word cur = freeRows[w] & (~(Word) 0 >> (63 - (from & 63)));
+        while (cur == 0) {
+            if (--w < 0)
+                return -1;
+            cur = freeRows[w];
+        }
+        int row = (w << 6) + 63 - __builtin_clzll(cur);
+        if (rowFree[builtRow(row)] > 0)
+            return row;
+        from = row - 1;
+    }
+    return -1;
+}
@@ -0,0 +1,92 @@
+#ifndef CELL_INDEX_HPP_
+#define CELL_INDEX_HPP_
+
+#include <cstddef>
+#include "data_structs.hpp"
+
+/*
+ * Per-row bitsets over the inner columns (1 .. cols-2) of the orchard, marking which cells still have apples 
+ * and which are occupied by workers. A cell is "free" when it has apples and no workers. Rows keep a count of 
+ * their free cells and a row-level bitset of non-empty rows, so searching for the next free cell costs 
+ * O(cols / 64 + rows / 64) word operations instead of a scan over cells.
+ * 
+ * The apple bits of a row are built from the orchard grid the first time the row is touched, so an index over 
+ * a memory-mapped yield map only reads the rows the simulation actually works in. Until then the row's free 
+ * count comes from the per-row counts given to attach().
+ */
+class CellIndex
+{
+public:
+    CellIndex();
+    
+    ~CellIndex();
+    
+    // grid: row-major orchard cells with the given row stride; rowCounts: non-empty inner cells in each row
+    void attach(const float *grid, int stride, int r, int c, const int *rowCounts);
+    
+    void setHasApples(Coordinate loc, bool hasApples);
+    
+    void setOccupied(Coordinate loc, bool occupied);
+    
+    bool hasApples(Coordinate loc) const { return isIndexed(loc) && testBit(builtRow(loc.y), apples, loc); }
+    
+    bool isOccupied(Coordinate loc) const { return isIndexed(loc) && testBit(loc.y, occupied, loc); }
+    
+    bool isFree(Coordinate loc) const { return hasApples(loc) && !isOccupied(loc); }
+    
+    long long getNumFreeCells() const { return numFree; }
+    
+    // First free column in [from, to] of the row, or -1
+    int findNextFree(int row, int from, int to) const;
+    
+    // Last free column in [to, from] of the row, or -1
+    int findPrevFree(int row, int from, int to) const;
+    
+    // First column in [from, to] of the row that still has apples, or -1
+    int findNextWithApples(int row, int from, int to) const;
+    
+    // First row >= from with at least one free cell, or -1
+    int findNextFreeRow(int from) const;
+    
+    // Last row <= from with at least one free cell, or -1
+    int findPrevFreeRow(int from) const;
+
+private:
+    typedef unsigned long long Word;
+    
+    const float *grid;
+    int stride;
+    int rows;
+    int cols;
+    int words; // Words per row
+    
+    // Lazily built state; calloc'd so untouched rows cost no resident memory
+    Word *apples;
+    Word *occupied;
+    unsigned char *built;
+    int *rowFree;
+    Word *freeRows; // Bit r set if rowFree[r] > 0
+    mutable long long numFree;
+    
+    CellIndex(const CellIndex &other);
+    CellIndex &operator=(const CellIndex &other);
+    
+    void release();
+    
+    bool isIndexed(Coordinate loc) const { return loc.x > 0 && loc.x < cols - 1 && loc.y >= 0 && loc.y < rows; }
+    
+    bool testBit(int row, const Word *bits, Coordinate loc) const
+    {
+        return (bits[(size_t) row * words + (loc.x >> 6)] >> (loc.x & 63)) & 1;
+    }
+    
+    int builtRow(int row) const;
+    
+    void setRowFree(int row, int count) const;
+    
+    void updateBit(Word *bits, Coordinate loc, bool value);
+    
+    int findNext(const Word *mask, int row, int from, int to) const;
+};
+
+#endif // CELL_INDEX_HPP_
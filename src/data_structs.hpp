@@ -26,6 +26,24 @@ struct AppleBin
     AppleBin(int i, int x, int y) : id(i), loc(x, y) { capacity = 0; fillRate = 1; onGround = false;  filledTime = -1; }
 };
 
+/*
+ * What an agent does over the next ticks while it has nothing to decide: it waits (speed 0) or moves speed steps 
+ * per tick towards dst, carrying the bin at index bin (-1 for none). It has something to decide again once it 
+ * gets within margin steps of dst, or stops on watch, in the repo column (with atRepo) or on a cell with a 
+ * location request (with clearsRequests).
+ */
+struct Trip
+{
+    Coordinate dst;
+    int speed;
+    int bin;
+    int margin;
+    Coordinate watch;
+    bool atRepo;
+    bool clearsRequests;
+    Trip() : dst(-1, -1), speed(0), bin(-1), margin(0), watch(-1, -1), atRepo(false), clearsRequests(false) {}
+};
+
 struct Worker
 {
     int id;
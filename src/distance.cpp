@@ -0,0 +1,163 @@
+#include <algorithm>
+#include "distance.hpp"
+
+static const int UNPACK_CHUNK = 64; // Destinations getStepCounts unpacks into x and y arrays at a time
+
+DistanceOracle::DistanceOracle(int r, int c)
+{
+    rows = 0;
+    cols = 0;
+    resize(r, c);
+}
+
+void DistanceOracle::resize(int r, int c)
+{
+    rows = r;
+    cols = c;
+    detour.resize(c > 0 ? c : 0);
+    for (int x = 0; x < c; ++x) {
+        int leftStep = x - 0;
+        int rightStep = c - 1 - x;
+        detour[x] = (leftStep <= rightStep) ? leftStep : rightStep;
+    }
+}
+
+void DistanceOracle::getStepCounts(Coordinate src, const int *xs, const int *ys, int n, int *out) const
+{
+    if (!isValid(src)) {
+        for (int i = 0; i < n; ++i)
+            out[i] = 0;
+        return;
+    }
+    
+    // Branch-free over the destinations. The bounds are copied first: out could alias them otherwise, and 
+    // reloading them every iteration keeps the loop from vectorizing.
+    const int numCols = cols;
+    const int numRows = rows;
+    int srcDetour = detour[src.x];
+    for (int i = 0; i < n; ++i) {
+        int dx = xs[i] - src.x;
+        int dy = ys[i] - src.y;
+        int valid = ((unsigned) xs[i] < (unsigned) numCols) & ((unsigned) ys[i] < (unsigned) numRows);
+        int steps = (dy != 0) * srcDetour + abs(dx) + abs(dy);
+        out[i] = valid * steps;
+    }
+}
+
+void DistanceOracle::getStepCounts(Coordinate src, const Coordinate *dsts, int n, int *out) const
+{
+    int xs[UNPACK_CHUNK];
+    int ys[UNPACK_CHUNK];
+    for (int first = 0; first < n; first += UNPACK_CHUNK) {
+        int m = std::min(UNPACK_CHUNK, n - first);
+        for (int i = 0; i < m; ++i) {
+            xs[i] = dsts[first + i].x;
+            ys[i] = dsts[first + i].y;
+        }
+        getStepCounts(src, xs, ys, m, out + first);
+    }
+}
+
+void DistanceOracle::getStepCounts(Coordinate src, const std::vector<Coordinate> &dsts, std::vector<int> &out) const
+{
+    out.resize(dsts.size());
+    if (!dsts.empty())
+        getStepCounts(src, &dsts[0], (int) dsts.size(), &out[0]);
+}
+
+/*
+ * The route from cur to target has up to three legs: along the current row to the nearer headland column, along 
+ * the headland to the target row, and along the target row to the target column. A target in column 0 is the 
+ * repo of the current row, so the agent only moves left. Legs are skipped when the agent is already on them. 
+ * On the first leg the agent jumps straight to the target column if that lies beyond the next cell towards the 
+ * headland, as the per-step movement always did.
+ */
+Coordinate DistanceOracle::advance(Coordinate cur, Coordinate target, int steps) const
+{
+    if (steps <= 0)
+        return cur;
+    
+    if (target.x == 0) { // Target location is the repo
+        cur.x = (cur.x - steps <= target.x) ? target.x : cur.x - steps;
+        return cur;
+    }
+    
+    if (cur.y != target.y && cur.x != 0 && cur.x != cols - 1) { // Travel to the headland column
+        int first, edge;
+        if (cur.x < cols - 1 - cur.x) {
+            first = (cur.x - 1 <= target.x) ? cur.x - 1 : target.x;
+            edge = 0;
+        } else {
+            first = (cur.x + 1 >= target.x) ? cur.x + 1 : target.x;
+            edge = cols - 1;
+        }
+        int legSteps = 1 + abs(edge - first);
+        if (steps < legSteps) {
+            cur.x = (edge < first) ? first - (steps - 1) : first + (steps - 1);
+            return cur;
+        }
+        cur.x = edge;
+        steps -= legSteps;
+    }
+    
+    if (cur.y != target.y) { // Travel along the headland
+        int dy = abs(target.y - cur.y);
+        if (steps < dy) {
+            cur.y += (target.y > cur.y) ? steps : -steps;
+            return cur;
+        }
+        cur.y = target.y;
+        steps -= dy;
+    }
+    
+    int dx = abs(target.x - cur.x); // Travel along the target row
+    if (steps < dx)
+        cur.x += (target.x > cur.x) ? steps : -steps;
+    else
+        cur.x = target.x;
+    return cur;
+}
+
+// Walks the legs of advance's route and finds loc on one of them
+int DistanceOracle::getRouteSteps(Coordinate cur, Coordinate target, Coordinate loc) const
+{
+    if (loc.x == cur.x && loc.y == cur.y)
+        return 0;
+    
+    if (target.x == 0) { // Target location is the repo
+        if (loc.y != cur.y || loc.x < target.x || loc.x > cur.x)
+            return -1;
+        return cur.x - loc.x;
+    }
+    
+    int steps = 0;
+    if (cur.y != target.y && cur.x != 0 && cur.x != cols - 1) { // Travel to the headland column
+        int first, edge;
+        if (cur.x < cols - 1 - cur.x) {
+            first = (cur.x - 1 <= target.x) ? cur.x - 1 : target.x;
+            edge = 0;
+        } else {
+            first = (cur.x + 1 >= target.x) ? cur.x + 1 : target.x;
+            edge = cols - 1;
+        }
+        if (loc.y == cur.y) { // The agent never comes back to this row
+            if (loc.x < std::min(first, edge) || loc.x > std::max(first, edge))
+                return -1;
+            return 1 + abs(loc.x - first);
+        }
+        steps = 1 + abs(edge - first);
+        cur.x = edge;
+    }
+    
+    if (cur.y != target.y) { // Travel along the headland
+        if (loc.x == cur.x && loc.y >= std::min(cur.y, target.y) && loc.y <= std::max(cur.y, target.y))
+            return steps + abs(loc.y - cur.y);
+        steps += abs(target.y - cur.y);
+        cur.y = target.y;
+    }
+    
+    // Travel along the target row
+    if (loc.y != cur.y || loc.x < std::min(cur.x, target.x) || loc.x > std::max(cur.x, target.x))
+        return -1;
+    return steps + abs(loc.x - cur.x);
+}
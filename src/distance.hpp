@@ -0,0 +1,59 @@
+#ifndef DISTANCE_HPP_
+#define DISTANCE_HPP_
+
+#include <cstdlib>
+#include <vector>
+#include "data_structs.hpp"
+
+/*
+ * Step counts for the headland-only movement model: agents travel along their row, and can only change rows in 
+ * the leftmost or rightmost column. A trip between rows therefore costs a detour to the nearer headland, which 
+ * depends only on the source column and is precomputed per column; the rest is the Manhattan distance. 
+ * One oracle is shared by all agents of an orchard.
+ */
+class DistanceOracle
+{
+public:
+    DistanceOracle(int r = 0, int c = 0);
+    
+    void resize(int r, int c);
+    
+    int getRows() const { return rows; }
+    
+    int getCols() const { return cols; }
+    
+    bool isValid(Coordinate loc) const
+    {
+        return ((unsigned) loc.x < (unsigned) cols && (unsigned) loc.y < (unsigned) rows);
+    }
+    
+    // Steps from src to dst, or 0 if either location is outside the orchard
+    int getStepCount(Coordinate src, Coordinate dst) const
+    {
+        if (!isValid(src) || !isValid(dst))
+            return 0;
+        int initStep = (src.y != dst.y) ? detour[src.x] : 0;
+        return initStep + abs(src.x - dst.x) + abs(src.y - dst.y);
+    }
+    
+    // Steps from one source to n destinations; out[i] = getStepCount(src, dsts[i])
+    void getStepCounts(Coordinate src, const Coordinate *dsts, int n, int *out) const;
+    
+    void getStepCounts(Coordinate src, const std::vector<Coordinate> &dsts, std::vector<int> &out) const;
+    
+    // As above for destinations packed as separate x and y arrays
+    void getStepCounts(Coordinate src, const int *xs, const int *ys, int n, int *out) const;
+    
+    // Location after moving the given number of steps from cur towards target, in O(1)
+    Coordinate advance(Coordinate cur, Coordinate target, int steps) const;
+    
+    // Steps advance takes from cur towards target to first stand on loc, or -1 if its route passes loc by
+    int getRouteSteps(Coordinate cur, Coordinate target, Coordinate loc) const;
+
+private:
+    int rows;
+    int cols;
+    std::vector<int> detour; // Steps from each column to the nearer headland column
+};
+
+#endif // DISTANCE_HPP_
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "event_queue.hpp"
+
+// Heap order: the earliest event on top
+static bool isLater(const Event &a, const Event &b)
+{
+    if (a.time != b.time)
+        return a.time > b.time;
+    if (a.kind != b.kind)
+        return a.kind > b.kind;
+    return a.index > b.index;
+}
+
+void EventQueue::push(int time, int kind, int index)
+{
+    heap.push_back(Event(time, kind, index));
+    std::push_heap(heap.begin(), heap.end(), isLater);
+}
+
+void EventQueue::pop()
+{
+    std::pop_heap(heap.begin(), heap.end(), isLater);
+    heap.pop_back();
+}
+
+const char *EventQueue::getKindName(int kind)
+{
+    switch (kind) {
+    case EVENT_TIME_LIMIT: return "time limit";
+    case EVENT_BIN_FULL: return "bin full";
+    case EVENT_BIN_STOPS: return "bin stops short of full";
+    case EVENT_APPLES_OUT: return "apples out";
+    case EVENT_REQUEST: return "location request";
+    case EVENT_AGENT_ARRIVES: return "agent arrives";
+    case EVENT_AGENT_STOPS: return "agent stops";
+    }
+    return "?";
+}
@@ -0,0 +1,54 @@
+#ifndef EVENT_QUEUE_HPP_
+#define EVENT_QUEUE_HPP_
+
+#include <vector>
+
+/*
+ * Upcoming events of an event jump (-events), earliest first. Every bin being picked forecasts when it fills up, 
+ * stops being picked short of full, runs out of apples (its workers move on and request a location) or requests 
+ * its own cell, and every agent on a trip when it arrives or stops where it has something to decide; the clock 
+ * jumps to the earliest of them. The tick that handles an event may change any forecast, so the run loop refills 
+ * the queue before every jump.
+ */
+enum EventKind
+{
+    EVENT_TIME_LIMIT,
+    EVENT_BIN_FULL,
+    EVENT_BIN_STOPS, // Stops being picked short of full; its workers start waiting
+    EVENT_APPLES_OUT, // The workers at the bin move on and request a location
+    EVENT_REQUEST, // A full bin requests its cell again
+    EVENT_AGENT_ARRIVES,
+    EVENT_AGENT_STOPS // Stops where it has something to decide, or its bin comes to or leaves the workers
+};
+
+struct Event
+{
+    int time;
+    int kind;
+    int index; // Bin or agent index, -1 for the time limit
+    Event(int t, int k, int i) : time(t), kind(k), index(i) {}
+};
+
+class EventQueue
+{
+public:
+    void clear() { heap.clear(); }
+    
+    bool empty() const { return heap.empty(); }
+    
+    int size() const { return (int) heap.size(); }
+    
+    void push(int time, int kind, int index);
+    
+    // Earliest event; ties go by kind, then index
+    const Event &top() const { return heap.front(); }
+    
+    void pop();
+    
+    static const char *getKindName(int kind);
+
+private:
+    std::vector<Event> heap;
+};
+
+#endif // EVENT_QUEUE_HPP_
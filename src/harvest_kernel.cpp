@@ -0,0 +1,95 @@
+#include <cmath>
+#include "params.hpp"
+#include "harvest_kernel.hpp"
+
+// round(c) < (int) BIN_CAPACITY exactly when c < this, without the libm call that keeps the loop from vectorizing
+static const float PICKED_UP_TO = (int) BIN_CAPACITY - 0.5f;
+
+void HarvestBatch::clear()
+{
+    x.clear();
+    y.clear();
+    capacity.clear();
+    apples.clear();
+    workers.clear();
+    open.clear();
+}
+
+void HarvestBatch::push(Coordinate loc, float cap, bool onGround, float remainingApples, int numWorkers)
+{
+    x.push_back(loc.x);
+    y.push_back(loc.y);
+    capacity.push_back(cap);
+    apples.push_back(remainingApples);
+    workers.push_back(numWorkers);
+    open.push_back(onGround ? 1 : 0);
+}
+
+void resolveCellOwners(HarvestBatch &batch, int rows, int cols)
+{
+    if ((int) batch.cellStamp.size() != rows * cols) {
+        batch.cellStamp.assign((size_t) rows * cols, 0);
+        batch.stamp = 0;
+    }
+    ++batch.stamp;
+    
+    for (int i = 0; i < batch.size(); ++i) {
+        if ((unsigned) batch.x[i] >= (unsigned) cols || (unsigned) batch.y[i] >= (unsigned) rows) {
+            batch.open[i] = 0;
+            continue;
+        }
+        int &cell = batch.cellStamp[(size_t) batch.y[i] * cols + batch.x[i]];
+        if (cell == batch.stamp)
+            batch.open[i] = 0; // An earlier bin, on the ground or carried, takes this cell's apples
+        cell = batch.stamp;
+    }
+}
+
+void harvestBatch(HarvestBatch &batch)
+{
+    int n = batch.size();
+    batch.harvested.resize(n);
+    batch.fillRate.resize(n);
+    batch.newCapacity.resize(n);
+    batch.full.resize(n);
+    if (n == 0)
+        return;
+    
+    // Same operations, in the same order, as filling the bins one by one in the run loop. Two loops, so each one 
+    // needs few enough run-time overlap checks between its arrays to vectorize.
+    const float *cap = &batch.capacity[0];
+    const float *apples = &batch.apples[0];
+    const int *num = &batch.workers[0];
+    const unsigned char *open = &batch.open[0];
+    unsigned char *harvested = &batch.harvested[0];
+    float *rate = &batch.fillRate[0];
+    float *newCap = &batch.newCapacity[0];
+    unsigned char *full = &batch.full[0];
+    for (int i = 0; i < n; ++i) {
+        // & rather than &&: every comparison runs, so the loop has no branch
+        harvested[i] = (open[i] != 0) & (apples[i] > 0) & (cap[i] < PICKED_UP_TO);
+        rate[i] = num[i] * PICK_RATE; // For every bin, kept below only where harvested
+    }
+    for (int i = 0; i < n; ++i) {
+        bool h = harvested[i];
+        float r = rate[i] * harvested[i]; // Exact: rates are finite, and never -0 either
+        float c = cap[i] + r; // Capacities are never -0, so adding 0 keeps them as they are
+        bool f = h & (c >= BIN_CAPACITY);
+        rate[i] = r;
+        newCap[i] = f ? BIN_CAPACITY : c;
+        full[i] = f;
+    }
+}
+
+void harvestBin(HarvestBatch &batch, int i, int numWorkers)
+{
+    batch.workers[i] = numWorkers;
+    bool h = batch.open[i] && batch.apples[i] > 0 && batch.capacity[i] < PICKED_UP_TO;
+    float r = numWorkers * PICK_RATE;
+    float c = batch.capacity[i] + r;
+    bool f = h && c >= BIN_CAPACITY;
+    batch.harvested[i] = h;
+    batch.fillRate[i] = h ? r : 0.0f;
+    batch.newCapacity[i] = f ? BIN_CAPACITY : (h ? c : batch.capacity[i]);
+    batch.full[i] = f;
+}
@@ -0,0 +1,49 @@
+#ifndef HARVEST_KERNEL_HPP_
+#define HARVEST_KERNEL_HPP_
+
+#include <vector>
+#include "data_structs.hpp"
+
+/*
+ * One tick of picking for every bin, packed as parallel arrays. Only the first bin at a cell is filled (the 
+ * others wait until it leaves), so ownership is resolved once per tick with a stamped cell grid instead of 
+ * comparing each bin against all earlier ones; the fill itself is two branch-free loops the compiler vectorizes.
+ */
+struct HarvestBatch
+{
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<float> capacity;
+    std::vector<float> apples; // Apples left at the bin location
+    std::vector<int> workers; // Workers at the bin location
+    std::vector<unsigned char> open; // On the ground; cleared by resolveCellOwners for all but the first bin at a cell
+    
+    // Filled by harvestBatch
+    std::vector<unsigned char> harvested;
+    std::vector<float> fillRate;
+    std::vector<float> newCapacity;
+    std::vector<unsigned char> full; // newCapacity reached BIN_CAPACITY this tick
+    
+    HarvestBatch() : stamp(0) {}
+    
+    int size() const { return (int) x.size(); }
+    
+    void clear();
+    
+    void push(Coordinate loc, float cap, bool onGround, float remainingApples, int numWorkers);
+    
+    // Scratch for resolveCellOwners: cellStamp[cell] == stamp when a bin already claimed the cell this tick
+    std::vector<int> cellStamp;
+    int stamp;
+};
+
+// Keeps open only the first bin at each cell of a rows x cols orchard; bins outside it never harvest
+void resolveCellOwners(HarvestBatch &batch, int rows, int cols);
+
+// Fill of every bin with the workers and apples packed in the batch
+void harvestBatch(HarvestBatch &batch);
+
+// Recomputes bin i alone with a different number of workers (when workers moved there earlier in the tick)
+void harvestBin(HarvestBatch &batch, int i, int numWorkers);
+
+#endif // HARVEST_KERNEL_HPP_
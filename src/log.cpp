@@ -0,0 +1,368 @@
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include "log.hpp"
+
+static const int LOG_MAX_ARGS = 12;
+static const int LOG_TEXT_SIZE = 128; // Copies of %s arguments
+static const unsigned long LOG_RING_SIZE = 1 << 12; // Power of two
+static const int LOG_OUT_SIZE = 1 << 16;
+
+union LogArg
+{
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+};
+
+struct LogRecord
+{
+    const char *format; // NULL when message holds the formatted message
+    int level;
+    int tag;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+    char *message; // malloc'd by the producer when the arguments could not be captured; freed once written
+};
+
+// Bounded multi-producer queue (Vyukov): a cell is free for ticket pos when seq == pos, full when seq == pos + 1
+struct LogCell
+{
+    unsigned long seq;
+    LogRecord rec;
+};
+
+static LogCell ring[LOG_RING_SIZE];
+static unsigned long enqueuePos;
+static unsigned long dequeuePos; // Formatter thread only
+static unsigned long writtenPos; // Events handed to stdio, published by the formatter
+static bool running; // Read by every producer; set with atomics
+static pthread_t formatter;
+static int stopping; // Set by logStop; the formatter exits once it has caught up
+static int sleeping; // Set by the formatter before it waits for wake; cleared by the producer that wakes it
+static pthread_mutex_t wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static char out[LOG_OUT_SIZE];
+static int outLen;
+
+// Skips flags, width, precision and length of the conversion at p (just past '%'); false for '*' widths
+static bool parseSpec(const char **p, int *longs)
+{
+    const char *s = *p;
+    while (*s != '\0' && strchr("-+ #0", *s) != NULL)
+        ++s;
+    while (isdigit((unsigned char) *s))
+        ++s;
+    if (*s == '.') {
+        ++s;
+        while (isdigit((unsigned char) *s))
+            ++s;
+    }
+    *longs = 0;
+    while (*s == 'l') {
+        ++*longs;
+        ++s;
+    }
+    while (*s == 'h')
+        ++s;
+    *p = s;
+    return *s != '*';
+}
+
+// Copies the arguments format consumes into rec; false if they do not fit or a conversion is not supported
+static bool capture(LogRecord &rec, const char *format, va_list ap)
+{
+    int n = 0;
+    int text = 0;
+    for (const char *p = format; *p != '\0'; ++p) {
+        if (*p != '%')
+            continue;
+        ++p;
+        if (*p == '%')
+            continue;
+        int longs;
+        if (!parseSpec(&p, &longs) || n == LOG_MAX_ARGS)
+            return false;
+        switch (*p) {
+        case 'd': case 'i': case 'c':
+            rec.args[n++].i = (longs == 0) ? va_arg(ap, int) : (longs == 1) ? va_arg(ap, long) : va_arg(ap, long long);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            rec.args[n++].u = (longs == 0) ? va_arg(ap, unsigned)
+                : (longs == 1) ? va_arg(ap, unsigned long) : va_arg(ap, unsigned long long);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            rec.args[n++].d = va_arg(ap, double);
+            break;
+        case 'p':
+            rec.args[n++].p = va_arg(ap, void *);
+            break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            if (s == NULL)
+                s = "(null)";
+            int len = (int) strlen(s);
+            if (text + len + 1 > LOG_TEXT_SIZE)
+                return false;
+            memcpy(rec.text + text, s, len + 1);
+            rec.args[n++].i = text;
+            text += len + 1;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fill(LogRecord &rec, int level, int tag, const char *format, va_list ap)
+{
+    rec.level = level;
+    rec.tag = tag;
+    rec.format = format;
+    rec.message = NULL;
+    va_list copy;
+    va_copy(copy, ap);
+    bool captured = capture(rec, format, copy);
+    va_end(copy);
+    if (captured)
+        return;
+    
+    // Too much text, too many arguments or a '*' width: format the whole message here instead
+    rec.format = NULL;
+    va_copy(copy, ap);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (len >= 0)
+        rec.message = (char *) malloc(len + 1);
+    if (rec.message != NULL)
+        vsnprintf(rec.message, len + 1, format, ap);
+    else
+        vsnprintf(rec.text, LOG_TEXT_SIZE, format, ap); // Out of memory; keep what fits
+}
+
+static void writeOut()
+{
+    fwrite(out, 1, outLen, stdout);
+    outLen = 0;
+}
+
+// Plain %d without snprintf; most arguments are coordinates and ids
+static int formatInt(char *dst, long long v)
+{
+    char digits[24];
+    int n = 0;
+    unsigned long long u = (v < 0) ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+    do {
+        digits[n++] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    int len = 0;
+    if (v < 0)
+        dst[len++] = '-';
+    while (n > 0)
+        dst[len++] = digits[--n];
+    return len;
+}
+
+// Errors and warnings go straight to stderr; stdout text is batched in out
+static void writeText(int level, const char *text, int len)
+{
+    if (level <= LOG_LEVEL_WARN) {
+        writeOut();
+        fwrite(text, 1, len, stderr);
+        return;
+    }
+    if (outLen + len > LOG_OUT_SIZE)
+        writeOut();
+    if (len > LOG_OUT_SIZE) {
+        fwrite(text, 1, len, stdout);
+        return;
+    }
+    memcpy(out + outLen, text, len);
+    outLen += len;
+}
+
+// Formats rec the way printf would have, and frees its message
+static void emit(LogRecord &rec)
+{
+    if (rec.format == NULL) {
+        const char *text = (rec.message != NULL) ? rec.message : rec.text;
+        writeText(rec.level, text, (int) strlen(text));
+        free(rec.message);
+        rec.message = NULL;
+        return;
+    }
+    
+    static char line[4096];
+    int len = 0;
+    int n = 0;
+    for (const char *p = rec.format; *p != '\0' && len < (int) sizeof(line) - 1; ++p) {
+        if (*p != '%') {
+            line[len++] = *p;
+            continue;
+        }
+        const char *start = p++;
+        if (*p == '%') {
+            line[len++] = '%';
+            continue;
+        }
+        int longs;
+        parseSpec(&p, &longs);
+        if (*p == 'd' && p == start + 1 && len + 24 < (int) sizeof(line)) {
+            len += formatInt(line + len, (int) rec.args[n++].i);
+            continue;
+        }
+        char spec[32];
+        int specLen = (int) (p - start) + 1;
+        if (specLen >= (int) sizeof(spec))
+            specLen = sizeof(spec) - 1;
+        memcpy(spec, start, specLen);
+        spec[specLen] = '\0';
+        
+        char *dst = line + len;
+        size_t room = sizeof(line) - len;
+        const LogArg &a = rec.args[n++];
+        int w;
+        switch (*p) {
+        case 'd': case 'i': case 'c':
+            w = (longs == 0) ? snprintf(dst, room, spec, (int) a.i)
+                : (longs == 1) ? snprintf(dst, room, spec, (long) a.i) : snprintf(dst, room, spec, a.i);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            w = (longs == 0) ? snprintf(dst, room, spec, (unsigned) a.u)
+                : (longs == 1) ? snprintf(dst, room, spec, (unsigned long) a.u) : snprintf(dst, room, spec, a.u);
+            break;
+        case 'p':
+            w = snprintf(dst, room, spec, a.p);
+            break;
+        case 's':
+            w = snprintf(dst, room, spec, rec.text + a.i);
+            break;
+        default:
+            w = snprintf(dst, room, spec, a.d);
+            break;
+        }
+        len += (w < (int) room) ? w : (int) room - 1;
+    }
+    if (len >= (int) sizeof(line))
+        len = sizeof(line) - 1;
+    writeText(rec.level, line, len);
+}
+
+// Sequentially consistent, so it cannot be ordered before the store that raises sleeping
+static bool isNextReady()
+{
+    return __atomic_load_n(&ring[dequeuePos & (LOG_RING_SIZE - 1)].seq, __ATOMIC_SEQ_CST) == dequeuePos + 1;
+}
+
+static void *formatterMain(void *)
+{
+    for (;;) {
+        LogCell &c = ring[dequeuePos & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&c.seq, __ATOMIC_ACQUIRE) == dequeuePos + 1) {
+            emit(c.rec);
+            __atomic_store_n(&c.seq, dequeuePos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+            ++dequeuePos;
+            continue;
+        }
+        
+        // Caught up: hand the batch to stdio and sleep until a producer finds the ring empty and wakes us. The 
+        // flag is raised before the ring is checked again, and producers publish before they check the flag, so 
+        // an event is either seen here or wakes the thread.
+        writeOut();
+        __atomic_store_n(&writtenPos, dequeuePos, __ATOMIC_RELEASE);
+        __atomic_store_n(&sleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&wakeLock);
+        while (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST) && !isNextReady() && !stopping)
+            pthread_cond_wait(&wake, &wakeLock);
+        __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+        bool stop = stopping && !isNextReady();
+        pthread_mutex_unlock(&wakeLock);
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+void logEvent(int level, int tag, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        vfprintf((level <= LOG_LEVEL_WARN) ? stderr : stdout, format, ap);
+        va_end(ap);
+        return;
+    }
+    
+    unsigned long pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+    for (;;) {
+        LogCell &c = ring[pos & (LOG_RING_SIZE - 1)];
+        long diff = (long) (__atomic_load_n(&c.seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                fill(c.rec, level, tag, format, ap);
+                __atomic_store_n(&c.seq, pos + 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+        } else {
+            if (diff < 0)
+                sched_yield(); // Ring full; let the formatter catch up
+            pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+    va_end(ap);
+    
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&wakeLock);
+        __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&wakeLock);
+    }
+}
+
+void logStart()
+{
+    static bool registered = false;
+    if (!registered) {
+        for (unsigned long i = 0; i < LOG_RING_SIZE; ++i)
+            ring[i].seq = i;
+        atexit(logFlush);
+        registered = true;
+    }
+    stopping = 0;
+    __atomic_store_n(&running, pthread_create(&formatter, NULL, formatterMain, NULL) == 0, __ATOMIC_RELEASE);
+}
+
+void logStop()
+{
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        return;
+    logFlush();
+    pthread_mutex_lock(&wakeLock);
+    stopping = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&wakeLock);
+    pthread_join(formatter, NULL);
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+}
+
+void logFlush()
+{
+    if (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        unsigned long target = __atomic_load_n(&enqueuePos, __ATOMIC_ACQUIRE);
+        while (__atomic_load_n(&writtenPos, __ATOMIC_ACQUIRE) < target) {
+            timespec ts = { 0, 20000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
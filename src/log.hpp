@@ -0,0 +1,63 @@
+#ifndef LOG_HPP_
+#define LOG_HPP_
+
+/*
+ * Structured logging. Every event has a level and a subsystem tag, both checked at compile time: an event above
+ * ORCHARD_LOG_LEVEL or with its tag's bit clear in ORCHARD_LOG_TAGS is a constant-false branch the compiler
+ * drops, and its arguments are never evaluated. A headless build (make LOG_LEVEL=0, or 3 to keep the run
+ * summaries) therefore pays nothing for logging on the hot path.
+ *
+ * An enabled event is not formatted where it happens. The caller copies the format pointer and the raw
+ * arguments into a lock-free ring buffer, and a formatter thread started by logStart turns them into text, in
+ * the order the events were logged. Errors and warnings go to stderr, everything else to stdout. Before
+ * logStart (and in programs that never call it) events are printed at once by the caller.
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3 // Run and episode summaries
+#define LOG_LEVEL_DEBUG 4 // Every tick and agent action
+
+#ifndef ORCHARD_LOG_LEVEL
+#define ORCHARD_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+enum LogTag
+{
+    LOG_SIM, // Run loop, episodes and command line
+    LOG_ORCHARD, // Orchard, yield maps and workers
+    LOG_HARVEST, // Bins, apples and location requests every tick
+    LOG_AGENT, // Agent actions
+    LOG_PLAN, // Plans and the auction
+    LOG_LEARN // Learned states
+};
+
+#ifndef ORCHARD_LOG_TAGS
+#define ORCHARD_LOG_TAGS 0xffffffffu
+#endif
+
+#define LOG_ENABLED(level, tag) ((level) <= ORCHARD_LOG_LEVEL && ((ORCHARD_LOG_TAGS >> (tag)) & 1u))
+
+#define LOG_AT(level, tag, ...) do { if (LOG_ENABLED(level, tag)) logEvent(level, tag, __VA_ARGS__); } while (0)
+
+#define LOG_ERROR(tag, ...) LOG_AT(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...) LOG_AT(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...) LOG_AT(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_AT(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+
+// Use the LOG_ macros instead. Events with at most 12 arguments and 128 bytes of %s text are captured without 
+// formatting; the caller formats any other event in full.
+void logEvent(int level, int tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// Starts the formatter thread
+void logStart();
+
+// Writes out every event logged so far and stops the formatter thread; events are printed at once until the next 
+// logStart. Call it before fork(), so the process forks with no other thread, and logStart again on both sides
+void logStop();
+
+// Waits until every event logged so far is written out; also runs at exit
+void logFlush();
+
+#endif // LOG_HPP_
@@ -1,60 +1,187 @@
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "params.hpp"
 #include "orchard.hpp"
+#include "yield_map.hpp"
+#include "log.hpp"
 
-Orchard::Orchard()
+Orchard::Orchard(int r, int c, const char *yieldMapPath)
 {
-    /* Initialize numbers of apples in each grid (uniform distribution). */
-    for (int i = 0; i < ORCH_ROWS; ++i) {
-        for (int j = 0; j < ORCH_COLS; ++j) {
-            if (j == 0 || j == ORCH_COLS - 1)
-                appleDist[i][j] = 0;
-            else
-                appleDist[i][j] = NUM_APPLES_PER_LOC;
+    rows = r;
+    cols = c;
+    mapBase = NULL;
+    mapLength = 0;
+    if (yieldMapPath != NULL) {
+        loadYieldMap(yieldMapPath);
+    } else {
+        allocate();
+        
+        /* Initialize numbers of apples in each grid (uniform distribution). */
+        for (int i = 0; i < rows; ++i) {
+            float *row = rowPtr(i);
+            for (int j = 1; j < cols - 1; ++j)
+                row[j] = NUM_APPLES_PER_LOC;
         }
+        initTotals();
     }
+    distance.resize(rows, cols);
 }
 
 Orchard::~Orchard()
 {
-    // TODO
+    if (mapBase != NULL)
+        munmap(mapBase, mapLength);
+    else
+        free(appleDist);
 }
 
-float Orchard::getApplesAt(Coordinate loc)
+void Orchard::loadYieldMap(const char *path)
 {
-    if (loc.x >= 0 && loc.x < ORCH_COLS && loc.y >= 0 && loc.y < ORCH_ROWS)
-        return appleDist[loc.y][loc.x];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        LOG_ERROR(LOG_ORCHARD, "Cannot open yield map %s.\n", path);
+        exit(1);
+    }
+    
+    // Private, lazily paged mapping: harvesting copies only the pages it writes and never touches the file
+    mapLength = st.st_size;
+    mapBase = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapBase == MAP_FAILED || mapLength < sizeof(YieldMapHeader)) {
+        LOG_ERROR(LOG_ORCHARD, "Cannot map yield map %s.\n", path);
+        exit(1);
+    }
+    const YieldMapHeader *h = (const YieldMapHeader *) mapBase;
+    if (!isValidYieldMapHeader(*h, mapLength)) {
+        LOG_ERROR(LOG_ORCHARD, "%s is not a valid yield map.\n", path);
+        exit(1);
+    }
+    
+    rows = h->rows;
+    cols = h->cols;
+    stride = h->stride;
+    appleDist = (float *) ((char *) mapBase + h->dataOffset);
+    totalApples = h->totalApples;
+    nonEmptyCells = (int) h->nonEmptyCells;
+    const char *rowInfo = (const char *) mapBase + h->rowInfoOffset;
+    rowApples.assign((const double *) rowInfo, (const double *) rowInfo + rows);
+    index.attach(appleDist, stride, rows, cols, (const int *) (rowInfo + rows * sizeof(double)));
+}
+
+void Orchard::allocate()
+{
+    stride = getRowStride(cols);
+    size_t bytes = (size_t) rows * stride * sizeof(float);
+    void *mem = NULL;
+    if (bytes == 0 || posix_memalign(&mem, CACHE_LINE_SIZE, bytes) != 0) {
+        LOG_ERROR(LOG_ORCHARD, "Cannot allocate %dx%d orchard.\n", rows, cols);
+        exit(1);
+    }
+    appleDist = (float *) mem;
+    memset(appleDist, 0, bytes); // Also clears the row padding
+}
+
+void Orchard::initTotals()
+{
+    rowApples.assign(rows, 0);
+    std::vector<int> rowCounts(rows, 0);
+    for (int i = 0; i < rows; ++i) {
+        const float *row = rowPtr(i);
+        for (int j = 0; j < stride; ++j) {
+            rowApples[i] += row[j];
+            rowCounts[i] += (j > 0 && j < cols - 1 && row[j] > 0);
+        }
+    }
+    totalApples = rescanTotalApples(&nonEmptyCells);
+    index.attach(appleDist, stride, rows, cols, &rowCounts[0]);
+}
+
+float Orchard::getApplesAt(Coordinate loc) const
+{
+    if (isInside(loc))
+        return rowPtr(loc.y)[loc.x];
     return 0;
 }
 
 void Orchard::decreaseApplesAt(Coordinate loc, float fillRate)
 {
-    if (loc.x < 0 || loc.x >= ORCH_COLS || loc.y < 0 || loc.y >= ORCH_ROWS)
+    if (!isInside(loc))
         return;
-    appleDist[loc.y][loc.x] = (fillRate >= appleDist[loc.y][loc.x]) ? 0 : appleDist[loc.y][loc.x] - fillRate;
+    float *cell = rowPtr(loc.y) + loc.x;
+    float before = (*cell);
+    (*cell) = (fillRate >= before) ? 0 : before - fillRate;
+    
+    double delta = (double) before - (double) (*cell);
+    rowApples[loc.y] -= delta;
+    totalApples -= delta;
+    if (before > 0 && (*cell) == 0) {
+        --nonEmptyCells;
+        index.setHasApples(loc, false);
+        if (nonEmptyCells == 0) // Snap away rounding so "no apples left" compares exactly
+            totalApples = 0;
+    }
 }
 
-double Orchard::getTotalApples(int *count)
+double Orchard::getTotalApples(int *count) const
+{
+#ifdef ORCHARD_DEBUG
+    checkTotals();
+#endif
+    (*count) = nonEmptyCells;
+    return totalApples;
+}
+
+double Orchard::rescanTotalApples(int *count) const
 {
     (*count) = 0;
     double total = 0;
-    for (int i = 0; i < ORCH_ROWS; ++i) {
-        for (int j = 0; j < ORCH_COLS; ++j) {
-            total += appleDist[i][j];
-            if (appleDist[i][j] > 0)
-                (*count)++;
+    for (int i = 0; i < rows; ++i) {
+        // Scan the whole padded row; padding is 0 and adds nothing
+        const float *row = rowPtr(i);
+        int nonEmpty = 0;
+        for (int j = 0; j < stride; ++j) {
+            total += row[j];
+            nonEmpty += (row[j] > 0);
         }
+        (*count) += nonEmpty;
     }
     return total;
 }
 
-float Orchard::getEstApplesRemaining(Coordinate loc, float estTime, float fillRate)
+bool Orchard::checkTotals() const
+{
+    bool ok = true;
+    int count = 0;
+    double total = rescanTotalApples(&count);
+    if (count != nonEmptyCells || fabs(total - totalApples) > 1e-3 * (1 + fabs(total))) {
+        LOG_ERROR(LOG_ORCHARD, "Orchard totals out of sync: tracked %4.2f in %d cells, actual %4.2f in %d cells.\n", 
+            totalApples, nonEmptyCells, total, count);
+        ok = false;
+    }
+    for (int i = 0; i < rows; ++i) {
+        const float *row = rowPtr(i);
+        double rowTotal = 0;
+        for (int j = 0; j < stride; ++j)
+            rowTotal += row[j];
+        if (fabs(rowTotal - rowApples[i]) > 1e-3 * (1 + fabs(rowTotal))) {
+            LOG_ERROR(LOG_ORCHARD, "Orchard row %d out of sync: tracked %4.2f, actual %4.2f.\n", i, rowApples[i], 
+                rowTotal);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+float Orchard::getEstApplesRemaining(Coordinate loc, float estTime, float fillRate) const
 {
-    float amount = appleDist[loc.y][loc.x] - (estTime * fillRate);
+    float amount = getApplesAt(loc) - (estTime * fillRate);
     amount = (amount >= 0) ? amount : 0;
     return amount;
 }
-
-
-
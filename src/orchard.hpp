@@ -4,26 +4,77 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include "params.hpp"
 #include "data_structs.hpp"
+#include "cell_index.hpp"
+#include "distance.hpp"
 
 class Orchard
 {
 public:
-    Orchard();
+    // Uniform orchard of r x c cells, or the apple distribution of a yield map file (which sets the size)
+    Orchard(int r = ORCH_ROWS, int c = ORCH_COLS, const char *yieldMapPath = NULL);
     
     ~Orchard();
     
-    float getApplesAt(Coordinate loc);
+    int getRows() const { return rows; }
+    
+    int getCols() const { return cols; }
+    
+    bool isInside(Coordinate loc) const
+    {
+        return ((unsigned) loc.x < (unsigned) cols && (unsigned) loc.y < (unsigned) rows);
+    }
+    
+    float getApplesAt(Coordinate loc) const;
     
     void decreaseApplesAt(Coordinate loc, float fillRate);
     
-    double getTotalApples(int *count);
+    double getTotalApples(int *count) const;
+    
+    double getRowApples(int r) const { return rowApples[r]; }
+    
+    int getNonEmptyCells() const { return nonEmptyCells; }
+    
+    double rescanTotalApples(int *count) const;
+    
+    bool checkTotals() const;
+    
+    const CellIndex &getCellIndex() const { return index; }
     
-    float getEstApplesRemaining(Coordinate loc, float estTime, float fillRate);
+    void setOccupied(Coordinate loc, bool occupied) { index.setOccupied(loc, occupied); }
+    
+    const DistanceOracle &getDistance() const { return distance; }
+    
+    float getEstApplesRemaining(Coordinate loc, float estTime, float fillRate) const;
 
 private:
-    float appleDist[ORCH_ROWS][ORCH_COLS];
+    int rows;
+    int cols;
+    int stride; // Floats per row, padded so every row starts on a cache line
+    float *appleDist; // Row-major, rows * stride; padding cells are always 0
+    void *mapBase; // Private mapping of a yield map file, or NULL when appleDist is heap-allocated
+    size_t mapLength;
+    
+    // Maintained by decreaseApplesAt so the totals never need a full rescan
+    double totalApples;
+    int nonEmptyCells;
+    std::vector<double> rowApples;
+    CellIndex index; // Harvestable (non-empty, unoccupied) cells for worker relocation
+    DistanceOracle distance; // Step counts between cells, shared by all agents
+    
+    // Not copyable; pass "const Orchard &" instead
+    Orchard(const Orchard &other);
+    Orchard &operator=(const Orchard &other);
+    
+    float *rowPtr(int r) const { return appleDist + (size_t) r * stride; }
+    
+    void allocate();
+    
+    void initTotals();
+    
+    void loadYieldMap(const char *path);
 };
 
 #endif // ORCHARD_HPP_
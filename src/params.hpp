@@ -1,8 +1,9 @@
 #ifndef PARAMS_HPP_
 #define PARAMS_HPP_
 
-const int ORCH_ROWS          = 5;
+const int ORCH_ROWS          = 5;  // Default orchard size; override with -r/-c at runtime
 const int ORCH_COLS          = 10;
+const int CACHE_LINE_SIZE    = 64; // Orchard rows are aligned and padded to this many bytes
 
 const int DEFAULT_NUM_AGENTS = 2;
 const int NUM_WORKERS        = 10;
@@ -16,5 +17,10 @@ const float AGENT_SPEED_H    = 2; // Agent speed when not carrying a bin: 9 grid
 const float AGENT_SPEED_L    = 1; // Agent speed when carrying a bin: 6 grids per time step
 
 const int DEFAULT_NUM_LAYERS = 3;
+const int PLANS_PER_BIN      = 3;      // Best plans an agent keeps for each bin it could go to first
+const int MAX_PLAN_NODES     = 100000; // Search nodes per agent per planning step
+
+const int MAX_DIR_LEN        = 128; // Longest -dir name; every log path built from it fits in PATH_LEN
+const int PATH_LEN           = 256;
 
 #endif // PARAMS_HPP_
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <ctime>
+#include "params.hpp"
+#include "plan_kernel.hpp"
+
+static const int DEADLINE_CHECK_NODES = 64; // Nodes expanded between clock reads
+
+double planClock()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void BinBatch::clear()
+{
+    x.clear();
+    y.clear();
+    capacity.clear();
+    fillRate.clear();
+    apples.clear();
+}
+
+void BinBatch::push(Coordinate loc, float cap, float rate, float remainingApples)
+{
+    x.push_back(loc.x);
+    y.push_back(loc.y);
+    capacity.push_back(cap);
+    fillRate.push_back(rate);
+    apples.push_back(remainingApples);
+}
+
+// round() without the libm call, so the loop below vectorizes. Exact for every float: adding and taking away 
+// 2^23 rounds |x| < 2^23 to nearest even, a tie that went down goes up instead, and larger floats are whole.
+static inline float roundHalfAway(float x)
+{
+    const float wholeFrom = 8388608.0f; // 2^23
+    float a = fabsf(x);
+    float even = (a + wholeFrom) - wholeFrom;
+    float tieDown = (float) (a - even == 0.5f);
+    return copysignf(((a < wholeFrom) ? even : a) + tieDown, x);
+}
+
+void scoreBinBatch(const DistanceOracle &dist, Coordinate src, BinBatch &batch)
+{
+    int n = batch.size();
+    batch.steps.resize(n);
+    batch.reachTime.resize(n);
+    batch.waitTime.resize(n);
+    batch.returnTime.resize(n);
+    if (n == 0)
+        return;
+    
+    dist.getStepCounts(src, &batch.x[0], &batch.y[0], n, &batch.steps[0]);
+    
+    // Same operations, in the same order, as AutoAgent::calcPathValues and calcWaitTime. Two loops, so each one 
+    // needs few enough run-time overlap checks between its arrays to vectorize.
+    const int *steps = &batch.steps[0];
+    const int *x = &batch.x[0];
+    const float *cap = &batch.capacity[0];
+    const float *rate = &batch.fillRate[0];
+    const float *apples = &batch.apples[0];
+    float *reach = &batch.reachTime[0];
+    float *wait = &batch.waitTime[0];
+    float *ret = &batch.returnTime[0];
+    for (int i = 0; i < n; ++i) {
+        reach[i] = ((float) steps[i]) / AGENT_SPEED_H;
+        ret[i] = (x[i] - 0) / AGENT_SPEED_L; // Repo at column 0
+    }
+    for (int i = 0; i < n; ++i) {
+        float harvestedApples = rate[i] * reach[i];
+        float remCapacity = BIN_CAPACITY - roundHalfAway(cap[i] + harvestedApples);
+        remCapacity = (remCapacity < 0) ? 0 : remCapacity;
+        // Every bin divides, so the loop has no branch: once its apples are gone by the time the agent gets 
+        // there, 0 by the fill rate (by 1 if that is 0 too)
+        bool picked = apples[i] - harvestedApples <= 0;
+        float w = picked ? 0.0f : remCapacity;
+        wait[i] = w / (rate[i] + ((picked && rate[i] == 0) ? 1.0f : 0.0f));
+    }
+}
+
+float sumPathTimes(const BinBatch &batch, const int *slots, int n)
+{
+    float sum = 0;
+    float prevTime = 0;
+    for (int j = 0; j < n && slots[j] != -1; ++j) {
+        int s = slots[j];
+        float time = prevTime + batch.reachTime[s] + batch.waitTime[s] + batch.returnTime[s];
+        sum += time;
+        prevTime = time;
+    }
+    return sum;
+}
+
+// Ascending value with NaN (a bin no worker will fill) after everything else
+static bool isBetter(float a, float b)
+{
+    return a < b || (b != b && a == a);
+}
+
+struct WorseFirst
+{
+    bool operator()(const PathScore &a, const PathScore &b) const { return isBetter(a.value, b.value); }
+};
+
+struct ByValue
+{
+    const std::vector<PathScore> *scores;
+    ByValue(const std::vector<PathScore> &s) : scores(&s) {}
+    bool operator()(int a, int b) const { return isBetter((*scores)[a].value, (*scores)[b].value); }
+};
+
+struct ByCost
+{
+    const std::vector<float> *cost;
+    ByCost(const std::vector<float> &c) : cost(&c) {}
+    bool operator()(int a, int b) const { return (*cost)[a] < (*cost)[b]; }
+};
+
+void PathSearch::search(const BinBatch &b, int numLayers, int topK, int nodeLimit, double limit)
+{
+    int n = b.size();
+    batch = &b;
+    length = (numLayers < n) ? numLayers : n;
+    k = (topK < 1) ? 1 : topK;
+    maxNodes = nodeLimit;
+    numNodes = 0;
+    deadline = limit;
+    nextCheck = DEADLINE_CHECK_NODES;
+    timedOut = false;
+    found.clear();
+    foundPaths.clear();
+    results.clear();
+    paths.clear();
+    if (length <= 0)
+        return;
+    
+    cost.resize(n);
+    byCost.resize(n);
+    for (int i = 0; i < n; ++i) {
+        float c = b.reachTime[i] + b.waitTime[i] + b.returnTime[i];
+        cost[i] = (c != c) ? FLT_MAX : c;
+        byCost[i] = i;
+    }
+    std::stable_sort(byCost.begin(), byCost.end(), ByCost(cost));
+    used.assign(n, 0);
+    path.resize(length);
+    pool.resize((size_t) k * length);
+    
+    for (int f = 0; f < n; ++f) {
+        heap.clear();
+        path[0] = f;
+        used[f] = 1;
+        completeCheapest(1);
+        offer();
+        if (!checkDeadline())
+            expand(1, cost[f], cost[f]);
+        used[f] = 0;
+        
+        for (int h = 0; h < (int) heap.size(); ++h) {
+            found.push_back(PathScore((int) foundPaths.size(), heap[h].value));
+            const int *p = &pool[(size_t) heap[h].first * length];
+            foundPaths.insert(foundPaths.end(), p, p + length);
+        }
+    }
+    
+    order.resize(found.size());
+    for (int i = 0; i < (int) order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), ByValue(found));
+    for (int i = 0; i < (int) order.size(); ++i) {
+        const PathScore &ps = found[order[i]];
+        const int *p = &foundPaths[ps.first];
+        results.push_back(PathScore(p[0], ps.value));
+        paths.insert(paths.end(), p, p + length);
+    }
+}
+
+// Cheapest completion of the first depth slots of path, plus its partial times
+float PathSearch::lowerBound(int depth, float prevTime, float sum) const
+{
+    int n = (int) byCost.size();
+    for (int i = 0; i < n && depth < length; ++i) {
+        if (used[byCost[i]])
+            continue;
+        prevTime += cost[byCost[i]];
+        sum += prevTime;
+        ++depth;
+    }
+    return sum;
+}
+
+void PathSearch::completeCheapest(int depth)
+{
+    int n = (int) byCost.size();
+    for (int i = 0; i < n && depth < length; ++i) {
+        if (!used[byCost[i]])
+            path[depth++] = byCost[i];
+    }
+}
+
+// Keeps the current path if it is among the k best of its first bin
+void PathSearch::offer()
+{
+    float value = sumPathTimes(*batch, &path[0], length);
+    if ((int) heap.size() == k && !isBetter(value, heap[0].value))
+        return;
+    for (int h = 0; h < (int) heap.size(); ++h) {
+        if (std::equal(path.begin(), path.end(), pool.begin() + (size_t) heap[h].first * length))
+            return; // The cheapest completion is found again by the search
+    }
+    
+    int entry = (int) heap.size();
+    if (entry == k) {
+        std::pop_heap(heap.begin(), heap.end(), WorseFirst());
+        entry = heap.back().first;
+        heap.pop_back();
+    }
+    std::copy(path.begin(), path.end(), pool.begin() + (size_t) entry * length);
+    heap.push_back(PathScore(entry, value));
+    std::push_heap(heap.begin(), heap.end(), WorseFirst());
+}
+
+// Reads the clock and records whether the deadline has passed; returns timedOut
+bool PathSearch::checkDeadline()
+{
+    if (deadline > 0 && !timedOut)
+        timedOut = planClock() > deadline;
+    return timedOut;
+}
+
+void PathSearch::expand(int depth, float prevTime, float sum)
+{
+    if (depth == length) {
+        offer();
+        return;
+    }
+    
+    // Children in ascending cost have ascending bounds, so the first one pruned ends the loop
+    int n = (int) byCost.size();
+    for (int i = 0; i < n && numNodes < maxNodes && !timedOut; ++i) {
+        int s = byCost[i];
+        if (used[s])
+            continue;
+        if (++numNodes >= nextCheck) {
+            nextCheck += DEADLINE_CHECK_NODES;
+            if (checkDeadline())
+                break;
+        }
+        float time = prevTime + cost[s];
+        used[s] = 1;
+        bool pruned = (int) heap.size() == k && !isBetter(lowerBound(depth + 1, time, sum + time), heap[0].value);
+        if (!pruned) {
+            path[depth] = s;
+            expand(depth + 1, time, sum + time);
+        }
+        used[s] = 0;
+        if (pruned)
+            break;
+    }
+}
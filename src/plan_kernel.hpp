@@ -0,0 +1,114 @@
+#ifndef PLAN_KERNEL_HPP_
+#define PLAN_KERNEL_HPP_
+
+#include <vector>
+#include "data_structs.hpp"
+#include "distance.hpp"
+
+/*
+ * Candidate bins of one planning step, packed as parallel arrays so the per-bin times can be computed in 
+ * branch-free loops the compiler vectorizes. Carried bins are packed at their carrier's destination with the 
+ * fill rate of the workers there, exactly as AutoAgent::calcPathValues sees them.
+ */
+struct BinBatch
+{
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<float> capacity;
+    std::vector<float> fillRate;
+    std::vector<float> apples; // Apples left at the bin location
+    
+    // Filled by scoreBinBatch
+    std::vector<int> steps;
+    std::vector<float> reachTime;
+    std::vector<float> waitTime;
+    std::vector<float> returnTime;
+    
+    int size() const { return (int) x.size(); }
+    
+    void clear();
+    
+    void push(Coordinate loc, float cap, float rate, float remainingApples);
+};
+
+// Reach, wait and return times of every bin in the batch for an agent at src
+void scoreBinBatch(const DistanceOracle &dist, Coordinate src, BinBatch &batch);
+
+// Value of visiting the given batch slots in order (a slot of -1 ends the path); equals calcPathValues bit for bit
+float sumPathTimes(const BinBatch &batch, const int *slots, int n);
+
+// Monotonic wall time in seconds, for planning deadlines
+double planClock();
+
+struct PathScore
+{
+    int first; // Batch slot the path starts with
+    float value;
+    PathScore(int f = -1, float v = 0) : first(f), value(v) {}
+};
+
+/*
+ * Branch-and-bound search over ordered paths of min(numLayers, batch size) distinct bins, scored with 
+ * sumPathTimes. A bin costs the same wherever it sits in a path, but it is counted once more for every bin 
+ * that follows, so the cheapest completion of a partial path takes the cheapest remaining bins in ascending 
+ * order; that completion is the lower bound used for pruning. The k best paths for every first bin are kept in 
+ * a bounded max-heap, and the whole search stops expanding after maxNodes nodes or at the deadline, whichever 
+ * comes first. Every first bin still gets its cheapest-completion path, so a limit only costs alternatives, never 
+ * a first bin: the search is anytime and returns the best paths found so far.
+ */
+class PathSearch
+{
+public:
+    PathSearch() : batch(NULL), length(0), k(0), maxNodes(0), numNodes(0), deadline(0), nextCheck(0), 
+        timedOut(false) {}
+    
+    // Results in ascending value; path i is getPath(i)[0 .. getPathLength() - 1]. deadline is a planClock time, 
+    // or 0 for none
+    void search(const BinBatch &batch, int numLayers, int k, int maxNodes, double deadline = 0);
+    
+    int size() const { return (int) results.size(); }
+    
+    const PathScore &operator[](int i) const { return results[i]; }
+    
+    const int *getPath(int i) const { return &paths[(size_t) i * length]; }
+    
+    int getPathLength() const { return length; }
+    
+    int getNumNodes() const { return numNodes; }
+    
+    // Whether the deadline stopped the last search early
+    bool isTimedOut() const { return timedOut; }
+
+private:
+    const BinBatch *batch;
+    int length;
+    int k;
+    int maxNodes;
+    int numNodes;
+    double deadline;
+    int nextCheck; // Node count at which the clock is read next
+    bool timedOut;
+    std::vector<float> cost; // Reach + wait + return of each slot
+    std::vector<int> byCost; // Slots in ascending cost
+    std::vector<unsigned char> used;
+    std::vector<int> path;
+    std::vector<PathScore> heap; // Up to k paths of the current first bin, worst on top; first is a pool entry
+    std::vector<int> pool; // Slots of the heap's paths, length per entry
+    std::vector<PathScore> found; // Kept paths of every first bin, pathOffset entries into foundPaths
+    std::vector<int> foundPaths;
+    std::vector<int> order;
+    std::vector<PathScore> results;
+    std::vector<int> paths;
+    
+    float lowerBound(int depth, float prevTime, float sum) const;
+    
+    void completeCheapest(int depth);
+    
+    void offer();
+    
+    bool checkDeadline();
+    
+    void expand(int depth, float prevTime, float sum);
+};
+
+#endif // PLAN_KERNEL_HPP_
@@ -0,0 +1,193 @@
+#include <cstddef>
+#include "request_queue.hpp"
+
+const RequestQueue::Cell *RequestQueue::findCell(Coordinate loc) const
+{
+    std::map<long long, Cell>::const_iterator it = cells.find(key(loc));
+    return (it == cells.end()) ? NULL : &it->second;
+}
+
+// Files the cell's request under served or unserved, and forgets cells with nothing left to track
+void RequestQueue::update(std::map<long long, Cell>::iterator it)
+{
+    Cell &c = it->second;
+    if (c.request != -1) {
+        if (c.served())
+            unserved.erase(orderKey(c.request));
+        else
+            unserved[orderKey(c.request)] = c.request;
+    }
+    if (c.request == -1 && !c.served())
+        cells.erase(it);
+}
+
+int RequestQueue::find(Coordinate loc) const
+{
+    const Cell *c = findCell(loc);
+    return (c == NULL) ? -1 : c->request;
+}
+
+int RequestQueue::getRegisTime(Coordinate loc) const
+{
+    int r = find(loc);
+    return (r == -1) ? -1 : entries[r].req.regisTime;
+}
+
+int RequestQueue::add(const LocationRequest &req)
+{
+    std::map<long long, Cell>::iterator it = cells.insert(std::make_pair(key(req.loc), Cell())).first;
+    if (it->second.request != -1)
+        return it->second.request;
+    
+    int r;
+    if (!freeEntries.empty()) {
+        r = freeEntries.back();
+        freeEntries.pop_back();
+    } else {
+        r = (int) entries.size();
+        entries.push_back(Entry());
+    }
+    entries[r].req = req;
+    entries[r].seq = seq++;
+    
+    // Requests normally arrive in time order, so the walk back from the tail stops at once
+    int p = tail;
+    while (p != -1 && entries[p].req.regisTime > req.regisTime)
+        p = entries[p].prev;
+    entries[r].prev = p;
+    entries[r].next = (p == -1) ? head : entries[p].next;
+    if (entries[r].next != -1)
+        entries[entries[r].next].prev = r;
+    else
+        tail = r;
+    if (p != -1)
+        entries[p].next = r;
+    else
+        head = r;
+    ++count;
+    
+    it->second.request = r;
+    update(it);
+    return r;
+}
+
+void RequestQueue::remove(int r)
+{
+    std::map<long long, Cell>::iterator it = cells.find(key(entries[r].req.loc));
+    unserved.erase(orderKey(r));
+    it->second.request = -1;
+    update(it);
+    
+    if (entries[r].prev != -1)
+        entries[entries[r].prev].next = entries[r].next;
+    else
+        head = entries[r].next;
+    if (entries[r].next != -1)
+        entries[entries[r].next].prev = entries[r].prev;
+    else
+        tail = entries[r].prev;
+    entries[r] = Entry();
+    freeEntries.push_back(r);
+    --count;
+}
+
+void RequestQueue::removeLocation(Coordinate loc)
+{
+    int r = find(loc);
+    if (r != -1)
+        remove(r);
+}
+
+void RequestQueue::clear()
+{
+    entries.clear();
+    freeEntries.clear();
+    head = -1;
+    tail = -1;
+    count = 0;
+    seq = 0;
+    cells.clear();
+    unserved.clear();
+    agentActive.clear();
+    agentTarget.clear();
+}
+
+void RequestQueue::setAgent(int a, Coordinate active, Coordinate target)
+{
+    if (a >= (int) agentActive.size()) {
+        agentActive.resize(a + 1, Coordinate(-1, -1));
+        agentTarget.resize(a + 1, Coordinate(-1, -1));
+    }
+    
+    Coordinate &oldActive = agentActive[a];
+    if (oldActive.x != active.x || oldActive.y != active.y) {
+        std::map<long long, Cell>::iterator it = cells.find(key(oldActive));
+        if (it != cells.end()) {
+            it->second.active.erase(a);
+            update(it);
+        }
+        it = cells.insert(std::make_pair(key(active), Cell())).first;
+        it->second.active.insert(a);
+        update(it);
+        oldActive = active;
+    }
+    
+    Coordinate &oldTarget = agentTarget[a];
+    if (oldTarget.x != target.x || oldTarget.y != target.y) {
+        std::map<long long, Cell>::iterator it = cells.find(key(oldTarget));
+        if (it != cells.end()) {
+            it->second.target.erase(a);
+            update(it);
+        }
+        it = cells.insert(std::make_pair(key(target), Cell())).first;
+        it->second.target.insert(a);
+        update(it);
+        oldTarget = target;
+    }
+}
+
+void RequestQueue::addGroundBin(Coordinate loc)
+{
+    std::map<long long, Cell>::iterator it = cells.insert(std::make_pair(key(loc), Cell())).first;
+    ++it->second.groundBins;
+    update(it);
+}
+
+void RequestQueue::removeGroundBin(Coordinate loc)
+{
+    std::map<long long, Cell>::iterator it = cells.find(key(loc));
+    if (it == cells.end() || it->second.groundBins == 0)
+        return;
+    --it->second.groundBins;
+    update(it);
+}
+
+bool RequestQueue::hasGroundBin(Coordinate loc) const
+{
+    const Cell *c = findCell(loc);
+    return c != NULL && c->groundBins > 0;
+}
+
+bool RequestQueue::isServed(Coordinate loc) const
+{
+    const Cell *c = findCell(loc);
+    return c != NULL && c->served();
+}
+
+int RequestQueue::getServingAgent(Coordinate loc, bool *isActive) const
+{
+    const Cell *c = findCell(loc);
+    int a = -1;
+    *isActive = false;
+    if (c == NULL)
+        return a;
+    if (!c->active.empty()) {
+        a = *c->active.begin();
+        *isActive = true;
+    }
+    if (!c->target.empty() && (a == -1 || *c->target.begin() < a)) {
+        a = *c->target.begin();
+        *isActive = false;
+    }
+    return a;
+}
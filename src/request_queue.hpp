@@ -0,0 +1,111 @@
+#ifndef REQUEST_QUEUE_HPP_
+#define REQUEST_QUEUE_HPP_
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "data_structs.hpp"
+
+/*
+ * Open location requests, at most one per cell, kept in a doubly linked list ordered by registration time (ties
+ * in insertion order). A cell map gives O(log n) dedupe, lookup and removal by location.
+ *
+ * The queue also records which cells are already served: by an agent whose active location or target is the
+ * cell, or by a bin on the ground there. Agents report their locations with setAgent and the world reports bin
+ * moves, so "is this request served" and "next unserved request" need no scan over agents or bins.
+ */
+class RequestQueue
+{
+public:
+    RequestQueue() { clear(); }
+    
+    int size() const { return count; }
+    
+    bool empty() const { return count == 0; }
+    
+    // Requests in order: for (int r = first(); r != -1; r = next(r))
+    int first() const { return head; }
+    
+    int next(int r) const { return entries[r].next; }
+    
+    const LocationRequest &get(int r) const { return entries[r].req; }
+    
+    // Request at loc, or -1
+    int find(Coordinate loc) const;
+    
+    // Registration time of the request at loc, or -1
+    int getRegisTime(Coordinate loc) const;
+    
+    // Adds the request unless its cell already has one; returns the request at that cell
+    int add(const LocationRequest &req);
+    
+    void remove(int r);
+    
+    void removeLocation(Coordinate loc);
+    
+    // Drops the requests and the served state
+    void clear();
+    
+    // Active location and target of agent a
+    void setAgent(int a, Coordinate active, Coordinate target);
+    
+    void addGroundBin(Coordinate loc);
+    
+    void removeGroundBin(Coordinate loc);
+    
+    bool hasGroundBin(Coordinate loc) const;
+    
+    bool isServed(Coordinate loc) const;
+    
+    // Lowest agent whose active location (preferred) or target is loc, or -1
+    int getServingAgent(Coordinate loc, bool *isActive) const;
+    
+    int getNumUnserved() const { return (int) unserved.size(); }
+    
+    // Oldest request nobody serves, or -1
+    int firstUnserved() const { return unserved.empty() ? -1 : unserved.begin()->second; }
+
+private:
+    typedef std::pair<int, long long> Key; // (regisTime, insertion sequence)
+    
+    struct Entry
+    {
+        LocationRequest req;
+        long long seq;
+        int prev;
+        int next;
+        Entry() : req(Coordinate(-1, -1)), seq(0), prev(-1), next(-1) {}
+    };
+    
+    struct Cell
+    {
+        int request;
+        int groundBins;
+        std::set<int> active; // Agents by id
+        std::set<int> target;
+        Cell() : request(-1), groundBins(0) {}
+        bool served() const { return groundBins > 0 || !active.empty() || !target.empty(); }
+    };
+    
+    std::vector<Entry> entries;
+    std::vector<int> freeEntries;
+    int head;
+    int tail;
+    int count;
+    long long seq;
+    std::map<long long, Cell> cells;
+    std::map<Key, int> unserved;
+    std::vector<Coordinate> agentActive;
+    std::vector<Coordinate> agentTarget;
+    
+    static long long key(Coordinate loc) { return ((unsigned long long) (unsigned) loc.y << 32) | (unsigned) loc.x; }
+    
+    Key orderKey(int r) const { return Key(entries[r].req.regisTime, entries[r].seq); }
+    
+    const Cell *findCell(Coordinate loc) const;
+    
+    void update(std::map<long long, Cell>::iterator it);
+};
+
+#endif // REQUEST_QUEUE_HPP_
@@ -0,0 +1,199 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "state_table.hpp"
+
+static const int MIN_SLOTS = 64;
+
+StateTable::Key StateTable::pack(const AutoState &s)
+{
+    Key k;
+    k.hi = ((Word) (unsigned) s.binStepCount << 32) | (unsigned) s.locStepCount;
+    k.lo = ((Word) (unsigned) s.binToLocStepCount << 32) | (unsigned) s.binEstFullTime;
+    return k;
+}
+
+// 64-bit finalizer (splitmix64) over both words
+StateTable::Word StateTable::hash(const Key &k)
+{
+    Word h = k.hi * 0x9e3779b97f4a7c15ULL ^ k.lo;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+int StateTable::probe(const Key &k) const
+{
+    int mask = (int) slots.size() - 1;
+    int i = (int) (hash(k) & mask);
+    while (slots[i].index != -1 && (slots[i].key.hi != k.hi || slots[i].key.lo != k.lo))
+        i = (i + 1) & mask;
+    return i;
+}
+
+int StateTable::find(const AutoState &s) const
+{
+    return slots[probe(pack(s))].index;
+}
+
+int StateTable::insert(const AutoState &s)
+{
+    Key k = pack(s);
+    int i = probe(k);
+    if (slots[i].index != -1)
+        return slots[i].index;
+    
+    if (2 * (size() + 1) > (int) slots.size()) {
+        grow();
+        i = probe(k);
+    }
+    slots[i].key = k;
+    slots[i].index = size();
+    keys.push_back(k);
+    rewards.push_back(s.reward);
+    return slots[i].index;
+}
+
+AutoState StateTable::get(int i) const
+{
+    const Key &k = keys[i];
+    return AutoState((int) (k.hi >> 32), (int) (unsigned) k.hi, (int) (k.lo >> 32), (int) (unsigned) k.lo, 
+        rewards[i]);
+}
+
+void StateTable::grow()
+{
+    slots.assign(slots.size() * 2, Slot());
+    for (int s = 0; s < size(); ++s) {
+        int i = probe(keys[s]);
+        slots[i].key = keys[s];
+        slots[i].index = s;
+    }
+}
+
+void StateTable::clear()
+{
+    keys.clear();
+    rewards.clear();
+    slots.assign(MIN_SLOTS, Slot());
+}
+
+void StateTable::merge(const StateTable &other)
+{
+    for (int s = 0; s < other.size(); ++s) {
+        AutoState st = other.get(s);
+        int i = find(st);
+        if (i == -1)
+            insert(st);
+        else
+            addReward(i, st.reward);
+    }
+}
+
+void StateTable::mergeShard(const StateTable &base, const StateTable &shard, float weight)
+{
+    for (int s = 0; s < shard.size(); ++s) {
+        AutoState st = shard.get(s);
+        float delta = (s < base.size()) ? st.reward - base.getReward(s) : st.reward; // A shard only appends
+        st.reward = 0;
+        addReward(insert(st), delta * weight);
+    }
+}
+
+bool StateTable::save(const char *path) const
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+    
+    StateFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, STATE_FILE_MAGIC, sizeof(h.magic));
+    h.version = STATE_FILE_VERSION;
+    h.numSlots = (int) slots.size();
+    h.numStates = size();
+    h.keysOffset = sizeof(h);
+    h.rewardsOffset = h.keysOffset + h.numStates * sizeof(Key);
+    h.slotsOffset = h.rewardsOffset + h.numStates * sizeof(float);
+    
+    std::vector<int> slotIndex(slots.size());
+    for (int i = 0; i < (int) slots.size(); ++i)
+        slotIndex[i] = slots[i].index;
+    
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    if (ok && size() > 0) {
+        ok = fwrite(&keys[0], sizeof(Key), keys.size(), fp) == keys.size()
+            && fwrite(&rewards[0], sizeof(float), rewards.size(), fp) == rewards.size();
+    }
+    ok = ok && fwrite(&slotIndex[0], sizeof(int), slotIndex.size(), fp) == slotIndex.size();
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
+
+static bool isValidStateFileHeader(const StateFileHeader &h, long long fileSize, long long keySize)
+{
+    if (memcmp(h.magic, STATE_FILE_MAGIC, sizeof(h.magic)) != 0 || h.version != STATE_FILE_VERSION)
+        return false;
+    if (h.numSlots < MIN_SLOTS || (h.numSlots & (h.numSlots - 1)) != 0 || h.numStates < 0 
+        || 2 * h.numStates > h.numSlots)
+        return false;
+    return h.keysOffset >= (long long) sizeof(h) && h.keysOffset % sizeof(long long) == 0
+        && h.rewardsOffset >= h.keysOffset + h.numStates * keySize
+        && h.slotsOffset >= h.rewardsOffset + h.numStates * (long long) sizeof(float)
+        && h.slotsOffset % sizeof(int) == 0 && h.slotsOffset + h.numSlots * (long long) sizeof(int) <= fileSize;
+}
+
+bool StateTable::load(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(StateFileHeader)) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    size_t length = st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    
+    const StateFileHeader *h = (const StateFileHeader *) base;
+    bool ok = isValidStateFileHeader(*h, length, sizeof(Key));
+    const int *slotIndex = ok ? (const int *) ((const char *) base + h->slotsOffset) : NULL;
+    // Every state in exactly one slot; a state in two slots would leave another one unreachable
+    std::vector<unsigned char> seen(ok ? h->numStates : 0, 0);
+    long long used = 0;
+    for (int i = 0; ok && i < h->numSlots; ++i) {
+        ok = slotIndex[i] >= -1 && slotIndex[i] < h->numStates;
+        if (ok && slotIndex[i] != -1) {
+            ok = !seen[slotIndex[i]];
+            seen[slotIndex[i]] = 1;
+            ++used;
+        }
+    }
+    ok = ok && used == h->numStates; // Leaves half the slots empty, so every probe ends
+    
+    if (ok) {
+        const Key *k = (const Key *) ((const char *) base + h->keysOffset);
+        const float *r = (const float *) ((const char *) base + h->rewardsOffset);
+        keys.assign(k, k + h->numStates);
+        rewards.assign(r, r + h->numStates);
+        slots.resize(h->numSlots);
+        for (int i = 0; i < h->numSlots; ++i) {
+            slots[i] = Slot();
+            if (slotIndex[i] != -1) {
+                slots[i].key = keys[slotIndex[i]];
+                slots[i].index = slotIndex[i];
+            }
+        }
+    }
+    munmap(base, length);
+    return ok;
+}
@@ -0,0 +1,105 @@
+#ifndef STATE_TABLE_HPP_
+#define STATE_TABLE_HPP_
+
+#include <vector>
+
+struct AutoState {
+    int binStepCount;
+    int locStepCount;
+    int binToLocStepCount;
+    int binEstFullTime; // estimated time until the bin is full
+    float reward;
+    AutoState(int b, int l, int d, int e, float r = 0) 
+        : binStepCount(b), locStepCount(l), binToLocStepCount(d), binEstFullTime(e), reward(r) {}
+};
+
+/*
+ * Saved state table: a header, the keys and rewards by state index, then the state index (or -1) of every hash 
+ * slot, so loading copies the table as it was without rehashing a single key.
+ */
+struct StateFileHeader
+{
+    char magic[8];
+    int version;
+    int numSlots;
+    long long numStates;
+    long long keysOffset;
+    long long rewardsOffset;
+    long long slotsOffset;
+};
+
+const char STATE_FILE_MAGIC[8] = { 'A', 'P', 'L', 'S', 'T', 'A', 'T', 'E' };
+const int STATE_FILE_VERSION = 1;
+
+/*
+ * Learned states, numbered densely in the order they were first seen. The four step count and time fields of a 
+ * state are packed into one 128-bit key (two 32-bit fields per word, so no value is lost, including the 
+ * estimated full time of a bin no worker fills) and indexed by an open-addressing table with linear probing, 
+ * kept at most half full. Keys and rewards are dense arrays by state index, so lookup and insert are O(1) 
+ * however many states training adds.
+ */
+class StateTable
+{
+public:
+    StateTable() { clear(); }
+    
+    int size() const { return (int) rewards.size(); }
+    
+    // Index of the state with the same fields as s, or -1
+    int find(const AutoState &s) const;
+    
+    // Index of s, added with s.reward if it is new
+    int insert(const AutoState &s);
+    
+    AutoState get(int i) const;
+    
+    float getReward(int i) const { return rewards[i]; }
+    
+    void addReward(int i, float reward) { rewards[i] += reward; }
+    
+    // Adds the states of other; the rewards of states in both tables are summed
+    void merge(const StateTable &other);
+    
+    // Adds weight times what shard learned since it was copied from base: the change in reward of every state, 
+    // new states counting from 0
+    void mergeShard(const StateTable &base, const StateTable &shard, float weight);
+    
+    void clear();
+    
+    bool save(const char *path) const;
+    
+    // Replaces the table with a saved one, read through a memory mapping; false (table unchanged) if the file is 
+    // missing or not a valid state file
+    bool load(const char *path);
+
+private:
+    typedef unsigned long long Word;
+    
+    struct Key
+    {
+        Word hi; // binStepCount, locStepCount
+        Word lo; // binToLocStepCount, binEstFullTime
+    };
+    
+    struct Slot
+    {
+        Key key;
+        int index; // -1 while empty
+        Slot() : index(-1) { key.hi = 0; key.lo = 0; }
+    };
+    
+    std::vector<Key> keys; // By state index
+    std::vector<float> rewards;
+    std::vector<Slot> slots; // Power of two
+    
+    static Key pack(const AutoState &s);
+    
+    static Word hash(const Key &k);
+    
+    // Slot holding k, or the empty slot where it belongs
+    int probe(const Key &k) const;
+    
+    void grow();
+};
+
+#endif // STATE_TABLE_HPP_
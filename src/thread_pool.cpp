@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "thread_pool.hpp"
+#include "log.hpp"
+
+ThreadPool::ThreadPool(int n)
+{
+    if (n <= 0)
+        n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    numThreads = (n < 1) ? 1 : n;
+    queues = new TaskQueue[numThreads];
+    for (int i = 0; i < numThreads; ++i)
+        pthread_mutex_init(&queues[i].lock, NULL);
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&start, NULL);
+    pthread_cond_init(&done, NULL);
+    generation = 0;
+    remaining = 0;
+    stopping = false;
+    func = NULL;
+    ctx = NULL;
+    
+    threads.resize(numThreads - 1);
+    args.resize(numThreads);
+    for (int i = 1; i < numThreads; ++i) {
+        args[i].pool = this;
+        args[i].index = i;
+        if (pthread_create(&threads[i - 1], NULL, threadMain, &args[i]) != 0) {
+            LOG_ERROR(LOG_SIM, "Cannot start thread %d.\n", i);
+            exit(1);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&start);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < (int) threads.size(); ++i)
+        pthread_join(threads[i], NULL);
+    
+    for (int i = 0; i < numThreads; ++i)
+        pthread_mutex_destroy(&queues[i].lock);
+    delete [] queues;
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&start);
+    pthread_cond_destroy(&done);
+}
+
+void *ThreadPool::threadMain(void *arg)
+{
+    ThreadPool *pool = ((ThreadArg *) arg)->pool;
+    int self = ((ThreadArg *) arg)->index;
+    int seen = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen && !pool->stopping)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stopping)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        pool->work(self);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Front of the own queue first, then the back of the others'
+bool ThreadPool::takeTask(int self, int *task)
+{
+    for (int k = 0; k < numThreads; ++k) {
+        TaskQueue &q = queues[(self + k) % numThreads];
+        pthread_mutex_lock(&q.lock);
+        bool found = !q.tasks.empty();
+        if (found && k == 0) {
+            *task = q.tasks.front();
+            q.tasks.pop_front();
+        } else if (found) {
+            *task = q.tasks.back();
+            q.tasks.pop_back();
+        }
+        pthread_mutex_unlock(&q.lock);
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(int self)
+{
+    // func and ctx are set before any task is queued, so a thread still leaving an earlier run that picks up a 
+    // task of this one also sees this run's function
+    int task;
+    while (takeTask(self, &task)) {
+        func(ctx, task);
+        pthread_mutex_lock(&lock);
+        if (--remaining == 0)
+            pthread_cond_signal(&done);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+void ThreadPool::run(TaskFunc f, void *c, int n)
+{
+    if (numThreads == 1 || n <= 1) {
+        for (int i = 0; i < n; ++i)
+            f(c, i);
+        return;
+    }
+    
+    pthread_mutex_lock(&lock);
+    func = f;
+    ctx = c;
+    remaining = n;
+    pthread_mutex_unlock(&lock);
+    
+    for (int t = 0; t < numThreads; ++t) {
+        TaskQueue &q = queues[t];
+        pthread_mutex_lock(&q.lock);
+        for (int i = (int) ((long long) n * t / numThreads); i < (int) ((long long) n * (t + 1) / numThreads); ++i)
+            q.tasks.push_back(i);
+        pthread_mutex_unlock(&q.lock);
+    }
+    
+    pthread_mutex_lock(&lock);
+    ++generation;
+    pthread_cond_broadcast(&start);
+    pthread_mutex_unlock(&lock);
+    
+    work(0);
+    
+    pthread_mutex_lock(&lock);
+    while (remaining > 0)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+/*
+ * Fixed set of threads for fork-join loops. run(func, ctx, n) deals tasks 0 .. n-1 out in contiguous chunks, 
+ * one task queue per thread; a thread works through its own queue from the front and, once it is empty, steals 
+ * from the back of the others, so uneven tasks still balance. The calling thread takes part as thread 0, and 
+ * run returns when every task has finished. With one thread, tasks run inline in order.
+ * 
+ * Tasks must not depend on each other or on which thread runs them.
+ */
+class ThreadPool
+{
+public:
+    typedef void (*TaskFunc)(void *ctx, int task);
+    
+    // n threads including the caller; 0 uses every online CPU
+    ThreadPool(int n = 1);
+    
+    ~ThreadPool();
+    
+    int getNumThreads() const { return numThreads; }
+    
+    void run(TaskFunc func, void *ctx, int n);
+
+private:
+    struct TaskQueue
+    {
+        pthread_mutex_t lock;
+        std::deque<int> tasks;
+    };
+    
+    struct ThreadArg
+    {
+        ThreadPool *pool;
+        int index;
+    };
+    
+    int numThreads;
+    std::vector<pthread_t> threads;
+    std::vector<ThreadArg> args;
+    TaskQueue *queues;
+    pthread_mutex_t lock; // Guards everything below
+    pthread_cond_t start;
+    pthread_cond_t done;
+    int generation; // Bumped by every run; workers wait for it to change
+    int remaining; // Tasks of the current run not finished yet
+    bool stopping;
+    TaskFunc func;
+    void *ctx;
+    
+    // Not copyable
+    ThreadPool(const ThreadPool &other);
+    ThreadPool &operator=(const ThreadPool &other);
+    
+    static void *threadMain(void *arg);
+    
+    bool takeTask(int self, int *task);
+    
+    void work(int self);
+};
+
+#endif // THREAD_POOL_HPP_
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include "trace.hpp"
+
+static const int MAX_PENDING_BLOCKS = 8; // The run loop waits when the writer thread falls this far behind
+static const int MAX_ENTITY_ID = 1 << 24;
+
+// How a column is coded: against the previous row, against the same entity's (agent's or bin's) previous row,
+// or as float bits xor the entity's previous bits. The entity id is column 1.
+enum ColumnCoding { ROW_DELTA, ENTITY_DELTA, ENTITY_XOR };
+
+static const int NUM_COLUMNS[TRACE_NUM_TABLES] = { 4, 5, 2 };
+
+static const int CODING[TRACE_NUM_TABLES][TRACE_MAX_COLUMNS] = {
+    { ROW_DELTA, ROW_DELTA, ENTITY_DELTA, ENTITY_DELTA, ROW_DELTA },
+    { ROW_DELTA, ROW_DELTA, ENTITY_DELTA, ENTITY_DELTA, ENTITY_XOR },
+    { ROW_DELTA, ROW_DELTA, ROW_DELTA, ROW_DELTA, ROW_DELTA }
+};
+
+bool makeDirs(const char *path)
+{
+    std::string dir(path);
+    for (size_t i = 1; i < dir.size(); ++i) {
+        if (dir[i] != '/')
+            continue;
+        dir[i] = '\0';
+        mkdir(dir.c_str(), 0755);
+        dir[i] = '/';
+    }
+    struct stat st;
+    return (mkdir(path, 0755) == 0 || errno == EEXIST) && stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void putVarint(std::vector<unsigned char> &out, unsigned u)
+{
+    while (u >= 0x80) {
+        out.push_back((unsigned char) (u | 0x80));
+        u >>= 7;
+    }
+    out.push_back((unsigned char) u);
+}
+
+// Small differences of either sign become small unsigned values
+static unsigned zigzag(unsigned d)
+{
+    return (d << 1) ^ (unsigned) -(int) (d >> 31);
+}
+
+static unsigned unzigzag(unsigned u)
+{
+    return (u >> 1) ^ (unsigned) -(int) (u & 1);
+}
+
+static void codeColumn(const std::vector<int> &values, const std::vector<int> &ids, int coding,
+    std::vector<unsigned> &prev, std::vector<unsigned char> &out)
+{
+    unsigned last = 0;
+    for (int r = 0; r < (int) values.size(); ++r) {
+        unsigned v = (unsigned) values[r];
+        if (coding == ROW_DELTA) {
+            putVarint(out, zigzag(v - last));
+            last = v;
+            continue;
+        }
+        unsigned &p = prev[ids[r]];
+        putVarint(out, (coding == ENTITY_XOR) ? v ^ p : zigzag(v - p));
+        p = v;
+    }
+}
+
+// False if the bytes do not hold exactly numRows values or an entity id is out of range
+static bool decodeColumn(const unsigned char *in, int numBytes, int numRows, const std::vector<int> &ids,
+    int coding, bool isIdColumn, std::vector<unsigned> &prev, std::vector<int> &values)
+{
+    values.resize(numRows);
+    const unsigned char *end = in + numBytes;
+    unsigned last = 0;
+    for (int r = 0; r < numRows; ++r) {
+        unsigned u = 0;
+        int shift = 0;
+        for (;;) {
+            if (in == end || shift > 28)
+                return false;
+            unsigned char byte = *in++;
+            u |= (unsigned) (byte & 0x7f) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+        
+        unsigned v;
+        if (coding == ROW_DELTA) {
+            v = last + unzigzag(u);
+            last = v;
+        } else {
+            unsigned &p = prev[ids[r]];
+            v = (coding == ENTITY_XOR) ? u ^ p : p + unzigzag(u);
+            p = v;
+        }
+        values[r] = (int) v;
+        if (isIdColumn && (values[r] < 0 || values[r] >= MAX_ENTITY_ID))
+            return false;
+    }
+    return in == end;
+}
+
+TraceWriter::TraceWriter()
+{
+    fp = NULL;
+    for (int t = 0; t < TRACE_NUM_TABLES; ++t)
+        filling[t] = NULL;
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&ready, NULL);
+    pthread_cond_init(&drained, NULL);
+    stopping = false;
+    failed = false;
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&ready);
+    pthread_cond_destroy(&drained);
+}
+
+bool TraceWriter::open(const char *path)
+{
+    close();
+    fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+    
+    TraceFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TRACE_FILE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_FILE_VERSION;
+    stopping = false;
+    failed = fwrite(&h, sizeof(h), 1, fp) != 1;
+    for (int t = 0; t < TRACE_NUM_TABLES; ++t)
+        filling[t] = takeSpare(t);
+    if (pthread_create(&thread, NULL, threadMain, this) != 0) {
+        fclose(fp);
+        fp = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool TraceWriter::close()
+{
+    if (fp == NULL)
+        return true;
+    
+    for (int t = 0; t < TRACE_NUM_TABLES; ++t) {
+        if (filling[t]->numRows > 0)
+            submit(t);
+    }
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    
+    bool ok = (fclose(fp) == 0) && !failed;
+    fp = NULL;
+    for (int i = 0; i < (int) blocks.size(); ++i)
+        delete blocks[i];
+    blocks.clear();
+    spare.clear();
+    for (int t = 0; t < TRACE_NUM_TABLES; ++t)
+        filling[t] = NULL;
+    return ok;
+}
+
+TraceWriter::Block *TraceWriter::takeSpare(int table)
+{
+    Block *b;
+    if (spare.empty()) {
+        b = new Block();
+        for (int c = 0; c < TRACE_MAX_COLUMNS; ++c)
+            b->columns[c].reserve(TRACE_BLOCK_ROWS);
+        blocks.push_back(b);
+    } else {
+        b = spare.back();
+        spare.pop_back();
+    }
+    b->table = table;
+    b->numRows = 0;
+    for (int c = 0; c < TRACE_MAX_COLUMNS; ++c)
+        b->columns[c].clear();
+    return b;
+}
+
+void TraceWriter::addRow(int table, const int *row)
+{
+    if (fp == NULL)
+        return;
+    Block *b = filling[table];
+    for (int c = 0; c < NUM_COLUMNS[table]; ++c)
+        b->columns[c].push_back(row[c]);
+    if (++b->numRows == TRACE_BLOCK_ROWS)
+        submit(table);
+}
+
+void TraceWriter::addAgent(int time, int agent, Coordinate loc)
+{
+    int row[] = { time, agent, loc.x, loc.y };
+    addRow(TRACE_AGENTS, row);
+}
+
+void TraceWriter::addBin(int time, const AppleBin &ab)
+{
+    int bits;
+    memcpy(&bits, &ab.capacity, sizeof(bits));
+    int row[] = { time, ab.id, ab.loc.x, ab.loc.y, bits };
+    addRow(TRACE_BINS, row);
+}
+
+void TraceWriter::addRepo(int time, int numDelivered)
+{
+    int row[] = { time, numDelivered };
+    addRow(TRACE_REPO, row);
+}
+
+void TraceWriter::submit(int table)
+{
+    pthread_mutex_lock(&lock);
+    while ((int) pending.size() >= MAX_PENDING_BLOCKS)
+        pthread_cond_wait(&drained, &lock);
+    pending.push_back(filling[table]);
+    pthread_cond_signal(&ready);
+    filling[table] = takeSpare(table);
+    pthread_mutex_unlock(&lock);
+}
+
+void *TraceWriter::threadMain(void *arg)
+{
+    TraceWriter *w = (TraceWriter *) arg;
+    std::vector<unsigned char> buf;
+    
+    pthread_mutex_lock(&w->lock);
+    while (true) {
+        while (w->pending.empty() && !w->stopping)
+            pthread_cond_wait(&w->ready, &w->lock);
+        if (w->pending.empty())
+            break;
+        Block *b = w->pending.front();
+        pthread_mutex_unlock(&w->lock);
+        bool ok = w->writeBlock(*b, buf);
+        pthread_mutex_lock(&w->lock);
+        w->pending.pop_front();
+        w->spare.push_back(b);
+        w->failed = w->failed || !ok;
+        pthread_cond_signal(&w->drained);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+bool TraceWriter::writeBlock(const Block &b, std::vector<unsigned char> &buf)
+{
+    TraceBlockHeader h;
+    memset(&h, 0, sizeof(h));
+    h.table = b.table;
+    h.numRows = b.numRows;
+    
+    buf.assign(sizeof(h), 0);
+    std::vector<unsigned> prev;
+    for (int c = 0; c < NUM_COLUMNS[b.table]; ++c) {
+        if (CODING[b.table][c] != ROW_DELTA && prev.empty()) {
+            int maxId = 0;
+            for (int r = 0; r < b.numRows; ++r)
+                maxId = std::max(maxId, b.columns[1][r]);
+            prev.resize(maxId + 1);
+        }
+        std::fill(prev.begin(), prev.end(), 0);
+        size_t start = buf.size();
+        codeColumn(b.columns[c], b.columns[1], CODING[b.table][c], prev, buf);
+        h.columnBytes[c] = (int) (buf.size() - start);
+    }
+    memcpy(&buf[0], &h, sizeof(h));
+    return fwrite(&buf[0], 1, buf.size(), fp) == buf.size();
+}
+
+bool TraceReader::open(const char *path)
+{
+    close();
+    damaged = false;
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+    
+    TraceFileHeader h;
+    if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, TRACE_FILE_MAGIC, sizeof(h.magic)) != 0
+        || h.version != TRACE_FILE_VERSION) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TraceReader::close()
+{
+    if (fp != NULL)
+        fclose(fp);
+    fp = NULL;
+}
+
+bool TraceReader::next(int *table, int *numRows, std::vector<int> *columns)
+{
+    if (fp == NULL || damaged)
+        return false;
+    
+    TraceBlockHeader h;
+    size_t n = fread(&h, 1, sizeof(h), fp);
+    if (n == 0)
+        return false;
+    damaged = true; // Until the block checks out
+    if (n != sizeof(h) || h.table < 0 || h.table >= TRACE_NUM_TABLES || h.numRows <= 0
+        || h.numRows > TRACE_BLOCK_ROWS)
+        return false;
+    int total = 0;
+    for (int c = 0; c < TRACE_MAX_COLUMNS; ++c) {
+        int limit = (c < NUM_COLUMNS[h.table]) ? 5 * h.numRows : 0; // A varint takes at most 5 bytes
+        if (h.columnBytes[c] < 0 || h.columnBytes[c] > limit)
+            return false;
+        total += h.columnBytes[c];
+    }
+    buf.resize(total);
+    if (total > 0 && fread(&buf[0], 1, total, fp) != (size_t) total)
+        return false;
+    
+    std::vector<unsigned> prev;
+    const unsigned char *in = (total > 0) ? &buf[0] : NULL;
+    for (int c = 0; c < NUM_COLUMNS[h.table]; ++c) {
+        int coding = CODING[h.table][c];
+        if (coding != ROW_DELTA && prev.empty()) {
+            int maxId = 0;
+            for (int r = 0; r < h.numRows; ++r)
+                maxId = std::max(maxId, columns[1][r]);
+            prev.resize(maxId + 1);
+        }
+        std::fill(prev.begin(), prev.end(), 0);
+        bool isIdColumn = (c == 1 && h.table != TRACE_REPO);
+        if (!decodeColumn(in, h.columnBytes[c], h.numRows, columns[1], coding, isIdColumn, prev, columns[c]))
+            return false;
+        in += h.columnBytes[c];
+    }
+    *table = h.table;
+    *numRows = h.numRows;
+    damaged = false;
+    return true;
+}
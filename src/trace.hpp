@@ -0,0 +1,136 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+#include "data_structs.hpp"
+
+/*
+ * Run trace: agent positions, bin states and repo counts of every time step in one append-only binary file, a
+ * header followed by blocks. A block holds up to TRACE_BLOCK_ROWS rows of one table, stored column by column.
+ * Coordinates and capacities are coded against the same agent's or bin's previous row in the block, times and
+ * ids against the previous row, and every value is written as a varint, so an agent or bin that did not change
+ * costs a few bytes per time step. Blocks decode on their own; rows of a table stay in the order they were
+ * added, across blocks.
+ *
+ * ./bin/tracedump turns a trace back into the CSV files the simulator used to write.
+ */
+enum TraceTable
+{
+    TRACE_AGENTS, // time, agent, x, y
+    TRACE_BINS, // time, bin, x, y, capacity (float bits)
+    TRACE_REPO, // time, bins delivered
+    TRACE_NUM_TABLES
+};
+
+const int TRACE_MAX_COLUMNS = 5;
+const int TRACE_BLOCK_ROWS = 1 << 14;
+
+struct TraceFileHeader
+{
+    char magic[8];
+    int version;
+    int reserved;
+};
+
+// Followed by the coded columns, columnBytes[c] bytes each
+struct TraceBlockHeader
+{
+    int table;
+    int numRows;
+    int columnBytes[TRACE_MAX_COLUMNS];
+};
+
+const char TRACE_FILE_MAGIC[8] = { 'A', 'P', 'L', 'T', 'R', 'A', 'C', 'E' };
+const int TRACE_FILE_VERSION = 1;
+
+// Creates path and any missing parent directories, like mkdir -p
+bool makeDirs(const char *path);
+
+/*
+ * Collects rows into blocks and hands full blocks to a background thread, which codes them and appends them to
+ * the file with one write each, so the run loop never formats or writes. Rows added while the file is not open
+ * are dropped.
+ */
+class TraceWriter
+{
+public:
+    TraceWriter();
+    
+    ~TraceWriter();
+    
+    // Truncates path and starts the writer thread; false if the file cannot be created
+    bool open(const char *path);
+    
+    // Writes the rows added so far and closes the file; false if any write failed
+    bool close();
+    
+    void addAgent(int time, int agent, Coordinate loc);
+    
+    void addBin(int time, const AppleBin &ab);
+    
+    void addRepo(int time, int numDelivered);
+
+private:
+    struct Block
+    {
+        int table;
+        int numRows;
+        std::vector<int> columns[TRACE_MAX_COLUMNS];
+    };
+    
+    FILE *fp;
+    Block *filling[TRACE_NUM_TABLES];
+    std::vector<Block *> blocks; // Every block, for freeing
+    pthread_t thread;
+    pthread_mutex_t lock; // Guards everything below
+    pthread_cond_t ready;
+    pthread_cond_t drained;
+    std::deque<Block *> pending; // Full blocks, oldest first
+    std::vector<Block *> spare;
+    bool stopping;
+    bool failed;
+    
+    // Not copyable
+    TraceWriter(const TraceWriter &other);
+    TraceWriter &operator=(const TraceWriter &other);
+    
+    Block *takeSpare(int table);
+    
+    void addRow(int table, const int *row);
+    
+    // Queues the table's block, waiting while too many blocks are pending
+    void submit(int table);
+    
+    static void *threadMain(void *arg);
+    
+    bool writeBlock(const Block &b, std::vector<unsigned char> &buf);
+};
+
+// Reads a trace block by block
+class TraceReader
+{
+public:
+    TraceReader() : fp(NULL), damaged(false) {}
+    
+    ~TraceReader() { close(); }
+    
+    // False if the file is missing or not a trace
+    bool open(const char *path);
+    
+    void close();
+    
+    // Decodes the next block into columns; false at the end of the file or at a damaged block
+    bool next(int *table, int *numRows, std::vector<int> *columns);
+    
+    bool isDamaged() const { return damaged; }
+
+private:
+    FILE *fp;
+    bool damaged;
+    std::vector<unsigned char> buf;
+};
+
+#endif // TRACE_HPP_
@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <cstdlib>
+#include "worker_model.hpp"
+#include "log.hpp"
+
+WorkerModel::WorkerModel(Orchard &o, int n)
+{
+    env = &o;
+    rows = o.getRows();
+    cols = o.getCols();
+    numGroups = 0;
+    cellGroup = (int *) calloc((size_t) rows * cols, sizeof(int));
+    if (cellGroup == NULL) {
+        LOG_ERROR(LOG_ORCHARD, "Cannot allocate worker grid.\n");
+        exit(1);
+    }
+    
+    group.assign(n, -1);
+    next.assign(n, -1);
+    prev.assign(n, -1);
+    for (int i = 0; i < n; ++i) {
+        workers.push_back(Worker(i, 0, 0));
+        place(i, Coordinate(0, 0));
+    }
+}
+
+WorkerModel::~WorkerModel()
+{
+    free(cellGroup);
+}
+
+// Key of a location outside the orchard in outsideGroup; either coordinate may be negative
+static long long outsideKey(Coordinate loc)
+{
+    return ((unsigned long long) (unsigned) loc.y << 32) | (unsigned) loc.x;
+}
+
+int WorkerModel::lookup(Coordinate loc) const
+{
+    if (env->isInside(loc))
+        return cellGroup[(size_t) loc.y * cols + loc.x] - 1;
+    std::map<long long, int>::const_iterator it = outsideGroup.find(outsideKey(loc));
+    return (it == outsideGroup.end()) ? -1 : it->second;
+}
+
+void WorkerModel::setCell(Coordinate loc, int g)
+{
+    if (env->isInside(loc)) {
+        cellGroup[(size_t) loc.y * cols + loc.x] = g + 1;
+        env->setOccupied(loc, g != -1);
+        return;
+    }
+    long long key = outsideKey(loc);
+    if (g == -1)
+        outsideGroup.erase(key);
+    else
+        outsideGroup[key] = g;
+}
+
+int WorkerModel::countAt(Coordinate loc) const
+{
+    int g = lookup(loc);
+    return (g == -1) ? 0 : groups[g].count;
+}
+
+int WorkerModel::getGroupAt(Coordinate loc) const
+{
+    return lookup(loc);
+}
+
+int WorkerModel::newGroup(Coordinate loc)
+{
+    int g;
+    if (!freeGroups.empty()) {
+        g = freeGroups.back();
+        freeGroups.pop_back();
+        groups[g] = Group();
+    } else {
+        g = (int) groups.size();
+        groups.push_back(Group());
+    }
+    groups[g].loc = loc;
+    setCell(loc, g);
+    ++numGroups;
+    return g;
+}
+
+void WorkerModel::releaseGroup(int g)
+{
+    setCell(groups[g].loc, -1);
+    groups[g] = Group();
+    freeGroups.push_back(g);
+    --numGroups;
+}
+
+void WorkerModel::link(int w, int g)
+{
+    group[w] = g;
+    prev[w] = -1;
+    next[w] = groups[g].head;
+    if (groups[g].head != -1)
+        prev[groups[g].head] = w;
+    groups[g].head = w;
+    ++groups[g].count;
+    workers[w].loc = groups[g].loc;
+}
+
+void WorkerModel::unlink(int w)
+{
+    int g = group[w];
+    if (prev[w] != -1)
+        next[prev[w]] = next[w];
+    else
+        groups[g].head = next[w];
+    if (next[w] != -1)
+        prev[next[w]] = prev[w];
+    next[w] = prev[w] = group[w] = -1;
+    if (--groups[g].count == 0)
+        releaseGroup(g);
+}
+
+void WorkerModel::place(int w, Coordinate loc)
+{
+    if (group[w] != -1)
+        unlink(w);
+    int g = lookup(loc);
+    if (g == -1)
+        g = newGroup(loc);
+    link(w, g);
+}
+
+void WorkerModel::moveGroup(Coordinate from, Coordinate to)
+{
+    int g = lookup(from);
+    if (g == -1 || (from.x == to.x && from.y == to.y))
+        return;
+    
+    int h = lookup(to);
+    if (h == -1) { // Nobody there; the group moves as a whole
+        setCell(from, -1);
+        groups[g].loc = to;
+        setCell(to, g);
+        for (int w = groups[g].head; w != -1; w = next[w])
+            workers[w].loc = to;
+        return;
+    }
+    
+    // Join the group already at the destination; unlinking the last member releases g
+    while (groups[g].count > 0) {
+        int w = groups[g].head;
+        unlink(w);
+        link(w, h);
+    }
+}
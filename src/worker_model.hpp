@@ -0,0 +1,91 @@
+#ifndef WORKER_MODEL_HPP_
+#define WORKER_MODEL_HPP_
+
+#include <map>
+#include <vector>
+#include "data_structs.hpp"
+#include "orchard.hpp"
+
+/*
+ * Pickers and where they work. Workers sharing a cell form a group; every cell holds at most one group, whose 
+ * members are kept in a doubly linked list over worker ids. A per-cell grid maps cells to groups, so the number 
+ * of workers at a cell is an O(1) lookup, and moving a whole group costs only its own size. The grid is 
+ * calloc'd and only the pages of cells that ever held workers are touched. Locations outside the orchard (a 
+ * group that found nowhere to go) are tracked in a small side map.
+ * 
+ * The model keeps the orchard's occupancy index up to date: a cell is occupied while it holds a group.
+ */
+class WorkerModel
+{
+public:
+    // n workers, all starting at (0,0)
+    WorkerModel(Orchard &o, int n = NUM_WORKERS);
+    
+    ~WorkerModel();
+    
+    const std::vector<Worker> &getWorkers() const { return workers; }
+    
+    int size() const { return (int) workers.size(); }
+    
+    int countAt(Coordinate loc) const;
+    
+    // Group working at loc, or -1
+    int getGroupAt(Coordinate loc) const;
+    
+    int getNumGroups() const { return numGroups; }
+    
+    Coordinate getGroupLoc(int g) const { return groups[g].loc; }
+    
+    int getGroupSize(int g) const { return groups[g].count; }
+    
+    // Members of a group: for (int w = getFirstMember(g); w != -1; w = getNextMember(w))
+    int getFirstMember(int g) const { return groups[g].head; }
+    
+    int getNextMember(int w) const { return next[w]; }
+    
+    // Move one worker to loc
+    void place(int w, Coordinate loc);
+    
+    // Move every worker at from to to, joining the group already there if any
+    void moveGroup(Coordinate from, Coordinate to);
+
+private:
+    struct Group
+    {
+        Coordinate loc;
+        int count;
+        int head;
+        Group() : loc(-1, -1), count(0), head(-1) {}
+    };
+    
+    Orchard *env;
+    int rows;
+    int cols;
+    std::vector<Worker> workers;
+    std::vector<int> group; // Group of each worker
+    std::vector<int> next; // Linked list of group members
+    std::vector<int> prev;
+    std::vector<Group> groups;
+    std::vector<int> freeGroups;
+    int numGroups;
+    int *cellGroup; // rows * cols; group id + 1 at each cell, 0 when empty
+    std::map<long long, int> outsideGroup; // Same for locations outside the orchard
+    
+    // Not copyable
+    WorkerModel(const WorkerModel &other);
+    WorkerModel &operator=(const WorkerModel &other);
+    
+    int lookup(Coordinate loc) const;
+    
+    void setCell(Coordinate loc, int g);
+    
+    int newGroup(Coordinate loc);
+    
+    void releaseGroup(int g);
+    
+    void link(int w, int g);
+    
+    void unlink(int w);
+};
+
+#endif // WORKER_MODEL_HPP_
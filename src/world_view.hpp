@@ -0,0 +1,126 @@
+#ifndef WORLD_VIEW_HPP_
+#define WORLD_VIEW_HPP_
+
+#include <vector>
+#include "data_structs.hpp"
+#include "orchard.hpp"
+#include "bin_store.hpp"
+#include "worker_model.hpp"
+#include "request_queue.hpp"
+
+// Read-only window onto a vector; never copies the elements
+template <class T>
+class ConstSpan
+{
+public:
+    ConstSpan(const std::vector<T> &v) : ptr(v.empty() ? NULL : &v[0]), n((int) v.size()) {}
+    
+    int size() const { return n; }
+    
+    bool empty() const { return n == 0; }
+    
+    const T &operator[](int i) const { return ptr[i]; }
+
+private:
+    const T *ptr;
+    int n;
+};
+
+/*
+ * Everything an agent needs to see of the simulation in one tick, without copying it: the orchard, the bins,
+ * the agents, the workers and the open location requests. The containers belong to the run loop; readers get
+ * const access, and every change an agent makes to the shared state goes through one of the commands below.
+ * The bin commands also keep the request queue's record of bins on the ground in step.
+ */
+template <class AgentT>
+class WorldView
+{
+public:
+    WorldView(const Orchard &o, BinStore &b, std::vector<AgentT> &a, const WorkerModel &w,
+        RequestQueue &r, std::vector<AppleBin> &rp, int *counter)
+        : env(&o), bins(&b), agents(&a), workers(&w), requests(&r), repo(&rp), binCounter(counter)
+    {
+        for (int i = 0; i < (int) b.size(); ++i) {
+            if (b[i].onGround)
+                r.addGroundBin(b[i].loc);
+        }
+    }
+    
+    const Orchard &getOrchard() const { return *env; }
+    
+    const BinStore &getBins() const { return *bins; }
+    
+    ConstSpan<AgentT> getAgents() const { return ConstSpan<AgentT>(*agents); }
+    
+    ConstSpan<Worker> getWorkers() const { return ConstSpan<Worker>(workers->getWorkers()); }
+    
+    int countWorkersAt(Coordinate loc) const { return workers->countAt(loc); }
+    
+    const RequestQueue &getRequests() const { return *requests; }
+    
+    int getNumDelivered() const { return (int) repo->size(); }
+    
+    // New empty bin at loc; returns its id
+    int createBin(Coordinate loc)
+    {
+        int id = (*binCounter)++;
+        bins->add(AppleBin(id, loc.x, loc.y));
+        return id;
+    }
+    
+    void moveBin(int index, Coordinate loc)
+    {
+        AppleBin &ab = (*bins)[index];
+        if (ab.onGround) {
+            requests->removeGroundBin(ab.loc);
+            requests->addGroundBin(loc);
+        }
+        ab.loc = loc;
+    }
+    
+    void dropBin(int index, Coordinate loc)
+    {
+        AppleBin &ab = (*bins)[index];
+        if (ab.onGround)
+            requests->removeGroundBin(ab.loc);
+        requests->addGroundBin(loc);
+        ab.loc = loc;
+        ab.onGround = true;
+    }
+    
+    void pickUpBin(int index)
+    {
+        AppleBin &ab = (*bins)[index];
+        if (ab.onGround)
+            requests->removeGroundBin(ab.loc);
+        ab.onGround = false;
+    }
+    
+    void setBinCapacity(int index, float capacity) { (*bins)[index].capacity = capacity; }
+    
+    // Move the bin to the repo as the given record
+    void deliverBin(int index, const AppleBin &record)
+    {
+        repo->push_back(record);
+        if ((*bins)[index].onGround)
+            requests->removeGroundBin((*bins)[index].loc);
+        bins->removeAt(index);
+        bins->compact(); // Agents read the bins through getBins() right after
+    }
+    
+    // r is a request handle from getRequests()
+    void removeRequest(int r) { requests->remove(r); }
+    
+    void removeRequests(Coordinate loc) { requests->removeLocation(loc); }
+
+private:
+    const Orchard *env;
+    BinStore *bins;
+    std::vector<AgentT> *agents;
+    const WorkerModel *workers;
+    RequestQueue *requests;
+    std::vector<AppleBin> *repo;
+    int *binCounter;
+};
+
+#endif // WORLD_VIEW_HPP_
@@ -0,0 +1,89 @@
+#include <cstring>
+#include "params.hpp"
+#include "yield_map.hpp"
+
+int getRowStride(int cols)
+{
+    const int perLine = CACHE_LINE_SIZE / sizeof(float);
+    return (cols + perLine - 1) / perLine * perLine;
+}
+
+bool isValidYieldMapHeader(const YieldMapHeader &h, long long fileSize)
+{
+    if (memcmp(h.magic, YIELD_MAP_MAGIC, sizeof(h.magic)) != 0 || h.version != YIELD_MAP_VERSION)
+        return false;
+    if (h.rows <= 0 || h.cols <= 0 || h.stride != getRowStride(h.cols) || h.dataOffset % YIELD_MAP_PAGE != 0)
+        return false;
+    long long gridBytes = (long long) h.rows * h.stride * sizeof(float);
+    long long rowInfoBytes = (long long) h.rows * (sizeof(double) + sizeof(int));
+    return h.dataOffset + gridBytes <= h.rowInfoOffset && h.rowInfoOffset + rowInfoBytes <= fileSize;
+}
+
+YieldMapWriter::YieldMapWriter()
+{
+    fp = NULL;
+}
+
+YieldMapWriter::~YieldMapWriter()
+{
+    if (fp != NULL)
+        fclose(fp);
+}
+
+bool YieldMapWriter::open(const char *path, int c)
+{
+    fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+    
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, YIELD_MAP_MAGIC, sizeof(header.magic));
+    header.version = YIELD_MAP_VERSION;
+    header.cols = c;
+    header.stride = getRowStride(c);
+    header.dataOffset = YIELD_MAP_PAGE;
+    rowBuf.assign(header.stride, 0);
+    rowTotals.clear();
+    rowCounts.clear();
+    
+    // Placeholder header; the real one is written by close() once the totals are known
+    std::vector<char> pad(YIELD_MAP_PAGE, 0);
+    return fwrite(&pad[0], 1, pad.size(), fp) == pad.size();
+}
+
+bool YieldMapWriter::writeRow(const float *values)
+{
+    double total = 0;
+    int count = 0;
+    for (int j = 0; j < header.cols; ++j) {
+        rowBuf[j] = (values[j] > 0) ? values[j] : 0;
+        total += rowBuf[j];
+        if (rowBuf[j] > 0) {
+            header.nonEmptyCells++;
+            if (j > 0 && j < header.cols - 1)
+                count++;
+        }
+    }
+    header.totalApples += total;
+    header.rows++;
+    rowTotals.push_back(total);
+    rowCounts.push_back(count);
+    return fwrite(&rowBuf[0], sizeof(float), rowBuf.size(), fp) == rowBuf.size();
+}
+
+bool YieldMapWriter::close()
+{
+    if (fp == NULL)
+        return false;
+    header.rowInfoOffset = header.dataOffset + (long long) header.rows * header.stride * sizeof(float);
+    bool ok = (header.rows > 0);
+    if (ok) {
+        ok = fwrite(&rowTotals[0], sizeof(double), rowTotals.size(), fp) == rowTotals.size()
+            && fwrite(&rowCounts[0], sizeof(int), rowCounts.size(), fp) == rowCounts.size()
+            && fseek(fp, 0, SEEK_SET) == 0
+            && fwrite(&header, sizeof(header), 1, fp) == 1;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    fp = NULL;
+    return ok;
+}
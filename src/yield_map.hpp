@@ -0,0 +1,56 @@
+#ifndef YIELD_MAP_HPP_
+#define YIELD_MAP_HPP_
+
+#include <cstdio>
+#include <vector>
+
+/*
+ * Binary yield map: a header, then the apple grid as rows of floats padded to the orchard row stride and 
+ * starting on a page boundary, then per-row totals (double) and per-row counts of non-empty inner cells (int). 
+ * The grid can be memory-mapped as-is and the header carries everything the Orchard would otherwise need a 
+ * full scan for.
+ */
+struct YieldMapHeader
+{
+    char magic[8];
+    int version;
+    int rows;
+    int cols;
+    int stride;
+    double totalApples;
+    long long nonEmptyCells;
+    long long dataOffset;
+    long long rowInfoOffset;
+};
+
+const char YIELD_MAP_MAGIC[8] = { 'A', 'P', 'L', 'Y', 'I', 'E', 'L', 'D' };
+const int YIELD_MAP_VERSION = 1;
+const int YIELD_MAP_PAGE = 4096;
+
+int getRowStride(int cols);
+
+bool isValidYieldMapHeader(const YieldMapHeader &h, long long fileSize);
+
+/* Streams a yield map to disk one row at a time, so converting a large raster never holds it in memory. */
+class YieldMapWriter
+{
+public:
+    YieldMapWriter();
+    
+    ~YieldMapWriter();
+    
+    bool open(const char *path, int c);
+    
+    bool writeRow(const float *values);
+    
+    bool close();
+
+private:
+    FILE *fp;
+    YieldMapHeader header;
+    std::vector<float> rowBuf;
+    std::vector<double> rowTotals;
+    std::vector<int> rowCounts;
+};
+
+#endif // YIELD_MAP_HPP_
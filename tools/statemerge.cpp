@@ -0,0 +1,35 @@
+#include <cstdio>
+#include "state_table.hpp"
+
+/*
+ * Merges learned state tables saved with "./bin/prog -auto -learn ... -save=<file>" into one. States found in 
+ * several tables get the sum of their rewards; the merged table loads with "-load=<file>".
+ * 
+ * Usage: ./bin/statemerge <output.st> <input.st> [<input.st> ...]
+ */
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("Usage: %s <output.st> <input.st> [<input.st> ...]\n", argv[0]);
+        return 1;
+    }
+    
+    StateTable merged;
+    StateTable table;
+    for (int i = 2; i < argc; ++i) {
+        if (!table.load(argv[i])) {
+            fprintf(stderr, "%s is not a valid state file.\n", argv[i]);
+            return 1;
+        }
+        merged.merge(table);
+        printf("%s: %d states.\n", argv[i], table.size());
+    }
+    
+    if (!merged.save(argv[1])) {
+        fprintf(stderr, "Cannot write %s.\n", argv[1]);
+        return 1;
+    }
+    printf("Wrote %d states to %s.\n", merged.size(), argv[1]);
+    return 0;
+}
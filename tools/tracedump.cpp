@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+/*
+ * Converts a run trace (logs/base/trace.bin or logs/auto/trace.bin) to the CSV files the simulator used to
+ * write: agents/agent<id>.csv (time, x, y), bins/bin<id>.csv (time, x, y, capacity) and repo.csv (time, bins
+ * delivered), with the rows of every episode in the order they were traced. The files go next to the trace
+ * unless an output directory is given.
+ *
+ * Usage: ./bin/tracedump <trace.bin> [<output dir>]
+ */
+
+const size_t FLUSH_SIZE = 1 << 14;
+
+// Rows of one CSV file, written out in chunks so thousands of bins do not need thousands of open files
+struct CsvFile
+{
+    std::string text;
+    bool created;
+    CsvFile() : created(false) {}
+};
+
+bool flushCsv(CsvFile &f, const char *path)
+{
+    FILE *fp = fopen(path, f.created ? "a" : "w");
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(f.text.data(), 1, f.text.size(), fp) == f.text.size();
+    ok = (fclose(fp) == 0) && ok;
+    f.text.clear();
+    f.created = true;
+    return ok;
+}
+
+// Appends a row to files[id], growing the list as needed, and flushes the file once it holds enough text
+bool addRow(std::vector<CsvFile> &files, int id, const char *row, const char *dir, const char *prefix)
+{
+    if (id >= (int) files.size())
+        files.resize(id + 1);
+    files[id].text += row;
+    if (files[id].text.size() < FLUSH_SIZE)
+        return true;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s%d.csv", dir, prefix, id);
+    return flushCsv(files[id], path);
+}
+
+bool flushAll(std::vector<CsvFile> &files, const char *dir, const char *prefix)
+{
+    bool ok = true;
+    for (int id = 0; id < (int) files.size(); ++id) {
+        if (files[id].text.empty()) // Flushed already, or an id that never appeared
+            continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s%d.csv", dir, prefix, id);
+        ok = flushCsv(files[id], path) && ok;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3) {
+        printf("Usage: %s <trace.bin> [<output dir>]\n", argv[0]);
+        return 1;
+    }
+    
+    TraceReader reader;
+    if (!reader.open(argv[1])) {
+        fprintf(stderr, "%s is not a valid trace file.\n", argv[1]);
+        return 1;
+    }
+    std::string out;
+    if (argc == 3) {
+        out = argv[2];
+    } else {
+        out = argv[1];
+        size_t slash = out.rfind('/');
+        out = (slash == std::string::npos) ? "." : out.substr(0, slash);
+    }
+    std::string agentDir = out + "/agents";
+    std::string binDir = out + "/bins";
+    if (!makeDirs(agentDir.c_str()) || !makeDirs(binDir.c_str())) {
+        fprintf(stderr, "Cannot create the directories under %s.\n", out.c_str());
+        return 1;
+    }
+    
+    std::vector<CsvFile> agents;
+    std::vector<CsvFile> bins;
+    CsvFile repo;
+    std::vector<int> columns[TRACE_MAX_COLUMNS];
+    int table;
+    int numRows;
+    long long counts[TRACE_NUM_TABLES] = { 0, 0, 0 };
+    bool ok = true;
+    char row[128];
+    while (ok && reader.next(&table, &numRows, columns)) {
+        counts[table] += numRows;
+        for (int r = 0; ok && r < numRows; ++r) {
+            if (table == TRACE_AGENTS) {
+                sprintf(row, "%d,%d,%d\n", columns[0][r], columns[2][r], columns[3][r]);
+                ok = addRow(agents, columns[1][r], row, agentDir.c_str(), "agent");
+            } else if (table == TRACE_BINS) {
+                float capacity;
+                memcpy(&capacity, &columns[4][r], sizeof(capacity));
+                sprintf(row, "%d,%d,%d,%4.2f\n", columns[0][r], columns[2][r], columns[3][r], capacity);
+                ok = addRow(bins, columns[1][r], row, binDir.c_str(), "bin");
+            } else {
+                sprintf(row, "%d,%d\n", columns[0][r], columns[1][r]);
+                repo.text += row;
+            }
+        }
+    }
+    if (reader.isDamaged())
+        fprintf(stderr, "%s is damaged; converted the rows before the damage.\n", argv[1]);
+    
+    std::string repoPath = out + "/repo.csv";
+    ok = flushAll(agents, agentDir.c_str(), "agent") && flushAll(bins, binDir.c_str(), "bin")
+        && flushCsv(repo, repoPath.c_str()) && ok;
+    if (!ok) {
+        fprintf(stderr, "Cannot write the CSV files under %s.\n", out.c_str());
+        return 1;
+    }
+    printf("%lld agent rows, %lld bin rows and %lld repo rows written to %s.\n", counts[TRACE_AGENTS],
+        counts[TRACE_BINS], counts[TRACE_REPO], out.c_str());
+    return reader.isDamaged() ? 1 : 0;
+}
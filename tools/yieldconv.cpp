@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "yield_map.hpp"
+
+/*
+ * Converts a CSV yield raster (one orchard row per line, comma-separated numbers of apples per tree, the first 
+ * and last columns being the headlands) to the binary yield map format loaded with "./bin/prog ... -y=<map>".
+ * 
+ * Usage: ./bin/yieldconv <input.csv> <output.ymap>
+ */
+
+int parseRow(char *line, std::vector<float> &values)
+{
+    values.clear();
+    for (char *tok = strtok(line, ",\r\n"); tok != NULL; tok = strtok(NULL, ",\r\n"))
+        values.push_back(strtof(tok, NULL));
+    return (int) values.size();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        printf("Usage: %s <input.csv> <output.ymap>\n", argv[0]);
+        return 1;
+    }
+    
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s.\n", argv[1]);
+        return 1;
+    }
+    
+    YieldMapWriter writer;
+    std::vector<float> values;
+    std::vector<char> line(1 << 16);
+    int cols = -1;
+    int rows = 0;
+    size_t len = 0;
+    
+    while (fgets(&line[len], (int) (line.size() - len), in) != NULL) {
+        len += strlen(&line[len]);
+        if (line[len - 1] != '\n' && !feof(in)) { // Line longer than the buffer; grow and keep reading
+            line.resize(line.size() * 2);
+            continue;
+        }
+        len = 0;
+        int n = parseRow(&line[0], values);
+        if (n == 0)
+            continue;
+        if (cols == -1) {
+            cols = n;
+            if (!writer.open(argv[2], cols)) {
+                fprintf(stderr, "Cannot write %s.\n", argv[2]);
+                return 1;
+            }
+        } else if (n != cols) {
+            fprintf(stderr, "Row %d has %d columns, expected %d.\n", rows, n, cols);
+            return 1;
+        }
+        if (!writer.writeRow(&values[0])) {
+            fprintf(stderr, "Failed to write row %d of yield map %s.\n", rows, argv[2]);
+            remove(argv[2]); // Its placeholder header would be rejected anyway
+            return 1;
+        }
+        ++rows;
+    }
+    fclose(in);
+    
+    if (rows == 0 || !writer.close()) {
+        fprintf(stderr, "Failed to write yield map %s.\n", argv[2]);
+        return 1;
+    }
+    printf("Wrote %dx%d yield map to %s.\n", rows, cols, argv[2]);
+    return 0;
+}